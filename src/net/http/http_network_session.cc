@@ -87,6 +87,8 @@ HttpNetworkSessionParams::HttpNetworkSessionParams()
       enable_http2(true),
       spdy_session_max_recv_window_size(kSpdySessionMaxRecvWindowSize),
       spdy_session_max_queued_capped_frames(kSpdySessionMaxQueuedCappedFrames),
+      spdy_session_write_coalescing_size(0),
+      spdy_recv_window_auto_tuning_limit(0),
 // For OSs that terminate TCP connections upon relevant network changes,
 // attempt to preserve active streams by marking all sessions as going
 // away, rather than explicitly closing them. Streams may still fail due
@@ -192,6 +194,8 @@ HttpNetworkSession::HttpNetworkSession(const HttpNetworkSessionParams& params,
                          params.enable_quic,
                          params.spdy_session_max_recv_window_size,
                          params.spdy_session_max_queued_capped_frames,
+                         params.spdy_session_write_coalescing_size,
+                         params.spdy_recv_window_auto_tuning_limit,
                          AddDefaultHttp2Settings(params.http2_settings),
                          params.enable_http2_settings_grease,
                          params.greased_http2_frame,
@@ -101,6 +101,13 @@ struct NET_EXPORT HttpNetworkSessionParams {
   size_t spdy_session_max_recv_window_size;
   // Maximum number of capped frames that can be queued at any time.
   int spdy_session_max_queued_capped_frames;
+  // Maximum number of bytes of ready frames that a SPDY session coalesces
+  // into a single socket write. Zero writes one frame at a time.
+  size_t spdy_session_write_coalescing_size;
+  // Size up to which SPDY session and stream receive windows grow when
+  // bandwidth-delay product samples show that they limit the peer. Zero
+  // keeps them at their initial sizes.
+  size_t spdy_recv_window_auto_tuning_limit;
   // Whether SPDY pools should mark sessions as going away upon relevant network
   // changes (instead of closing them). Default value is OS specific.
   bool spdy_go_away_on_ip_change;
@@ -1740,6 +1740,20 @@ EVENT_TYPE(HTTP2_STREAM_UPDATE_RECV_WINDOW)
 //   }
 EVENT_TYPE(HTTP2_STREAM_ERROR)
 
+// Summary of a stream, logged when it closes.
+//   {
+//     "stream_id":                  <The stream id>,
+//     "lifetime_ms":                <Time since the request headers were
+//                                    sent>,
+//     "send_bytes":                 <DATA payload bytes sent>,
+//     "recv_bytes":                 <DATA payload bytes received>,
+//     "send_stalls":                <Times sending stalled on flow control>,
+//     "send_stalled_by_stream_ms":  <Time stalled on the stream send window>,
+//     "send_stalled_by_session_ms": <Time stalled on the session send
+//                                    window>,
+//   }
+EVENT_TYPE(HTTP2_STREAM_STATS)
+
 // A PRIORITY update is sent to the server.
 //   {
 //     "stream_id":        <The stream id>,
@@ -4161,3 +4175,16 @@ EVENT_TYPE(WEBSOCKET_INVALID_FRAME)
 //     "host_found_in_hsts_bypass_list": <boolean>,
 //   }
 EVENT_TYPE(TRANSPORT_SECURITY_STATE_SHOULD_UPGRADE_TO_SSL)
+
+// ------------------------------------------------------------------------
+// NaiveProxy
+// ------------------------------------------------------------------------
+
+// This event is logged when a NaiveConnection changes the read size used for
+// one side of the relay. It contains the following parameters:
+// {
+//    "connection_id": <The connection ID>,
+//    "direction": <"client" or "server", the side being read>,
+//    "read_size": <New read size in bytes>,
+// }
+EVENT_TYPE(NAIVE_CONNECTION_READ_SIZE_CHANGED)
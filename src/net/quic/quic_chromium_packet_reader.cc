@@ -4,6 +4,8 @@
 
 #include "net/quic/quic_chromium_packet_reader.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/location.h"
 #include "base/metrics/histogram_macros.h"
@@ -20,6 +22,8 @@ namespace {
 // when the packet length is equal to the read buffer size.
 const size_t kReadBufferSize =
     static_cast<size_t>(quic::kMaxIncomingPacketSize + 1);
+// Large enough for the datagrams the kernel coalesces into one read.
+const int kCoalescedReadSize = 64 * 1024;
 }  // namespace
 
 QuicChromiumPacketReader::QuicChromiumPacketReader(
@@ -37,8 +41,18 @@ QuicChromiumPacketReader::QuicChromiumPacketReader(
       yield_after_packets_(yield_after_packets),
       yield_after_duration_(yield_after_duration),
       yield_after_(quic::QuicTime::Infinite()),
-      read_buffer_(base::MakeRefCounted<IOBufferWithSize>(kReadBufferSize)),
-      net_log_(net_log) {}
+      read_slot_size_(static_cast<int>(kReadBufferSize)),
+      read_num_slots_(kMaxPacketsPerRead),
+      read_multiple_(true),
+      addresses_cached_(false),
+      net_log_(net_log) {
+  if (socket_->EnableReceiveCoalescing() == OK) {
+    read_slot_size_ = kCoalescedReadSize;
+    read_num_slots_ = kMaxCoalescedReadsPerRead;
+  }
+  read_buffer_ = base::MakeRefCounted<IOBufferWithSize>(read_slot_size_ *
+                                                        read_num_slots_);
+}
 
 QuicChromiumPacketReader::~QuicChromiumPacketReader() {}
 
@@ -52,17 +66,27 @@ void QuicChromiumPacketReader::StartReading() {
 
     CHECK(socket_);
     read_pending_ = true;
-    int rv =
-        socket_->Read(read_buffer_.get(), read_buffer_->size(),
-                      base::BindOnce(&QuicChromiumPacketReader::OnReadComplete,
-                                     weak_factory_.GetWeakPtr()));
+    int rv;
+    if (read_multiple_) {
+      rv = socket_->ReadMultiple(
+          read_buffer_.get(), read_slot_size_, read_num_slots_, read_lengths_,
+          read_segment_sizes_,
+          base::BindOnce(&QuicChromiumPacketReader::OnReadComplete,
+                         weak_factory_.GetWeakPtr()));
+    } else {
+      rv = socket_->Read(
+          read_buffer_.get(), kReadBufferSize,
+          base::BindOnce(&QuicChromiumPacketReader::OnReadComplete,
+                         weak_factory_.GetWeakPtr()));
+    }
     UMA_HISTOGRAM_BOOLEAN("Net.QuicSession.AsyncRead", rv == ERR_IO_PENDING);
     if (rv == ERR_IO_PENDING) {
       num_packets_read_ = 0;
       return;
     }
 
-    if (++num_packets_read_ > yield_after_packets_ ||
+    num_packets_read_ += (read_multiple_ && rv > 0) ? CountDatagrams(rv) : 1;
+    if (num_packets_read_ > yield_after_packets_ ||
         clock_->Now() > yield_after_) {
       num_packets_read_ = 0;
       // Data was read, process it.
@@ -80,7 +104,63 @@ void QuicChromiumPacketReader::StartReading() {
 }
 
 bool QuicChromiumPacketReader::ProcessReadResult(int result) {
+  if (read_multiple_)
+    return ProcessReadMultipleResult(result);
   read_pending_ = false;
+  return ProcessPacket(read_buffer_->data(), result, clock_->Now());
+}
+
+bool QuicChromiumPacketReader::ProcessReadMultipleResult(int result) {
+  read_pending_ = false;
+  if (result == ERR_NOT_IMPLEMENTED) {
+    // Fall back to reading one datagram at a time.
+    read_multiple_ = false;
+    return true;
+  }
+  // All datagrams of a batch were received by the same system call.
+  quic::QuicTime now = clock_->Now();
+  if (result < 0)
+    return ProcessPacket(nullptr, result, now);
+  // |this| may be gone once ProcessPacket() returns false.
+  for (int i = 0; i < result; ++i) {
+    const char* data = read_buffer_->data() + i * read_slot_size_;
+    int length = read_lengths_[i];
+    if (length <= 0) {
+      if (!ProcessPacket(data, length, now))
+        return false;
+      continue;
+    }
+    // A coalesced slot holds datagrams of |segment_size| bytes, the last one
+    // possibly shorter.
+    int segment_size = read_segment_sizes_[i];
+    DCHECK_GT(segment_size, 0);
+    for (int offset = 0; offset < length; offset += segment_size) {
+      if (!ProcessPacket(data + offset,
+                         std::min(segment_size, length - offset), now)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int QuicChromiumPacketReader::CountDatagrams(int result) const {
+  int num_datagrams = 0;
+  for (int i = 0; i < result; ++i) {
+    int length = read_lengths_[i];
+    int segment_size = read_segment_sizes_[i];
+    if (length <= 0 || segment_size <= 0) {
+      ++num_datagrams;
+      continue;
+    }
+    num_datagrams += (length + segment_size - 1) / segment_size;
+  }
+  return num_datagrams;
+}
+
+bool QuicChromiumPacketReader::ProcessPacket(const char* data,
+                                             int result,
+                                             quic::QuicTime now) {
   if (result <= 0 && net_log_.IsCapturing()) {
     net_log_.AddEventWithIntParams(NetLogEventType::QUIC_READ_ERROR,
                                    "net_error", result);
@@ -99,17 +179,20 @@ bool QuicChromiumPacketReader::ProcessReadResult(int result) {
     return visitor_->OnReadError(result, socket_);
   }
 
-  quic::QuicReceivedPacket packet(read_buffer_->data(), result, clock_->Now());
-  IPEndPoint local_address;
-  IPEndPoint peer_address;
-  socket_->GetLocalAddress(&local_address);
-  socket_->GetPeerAddress(&peer_address);
+  quic::QuicReceivedPacket packet(data, result, now);
+  if (!addresses_cached_) {
+    IPEndPoint local_address;
+    IPEndPoint peer_address;
+    socket_->GetLocalAddress(&local_address);
+    socket_->GetPeerAddress(&peer_address);
+    local_address_ = ToQuicSocketAddress(local_address);
+    peer_address_ = ToQuicSocketAddress(peer_address);
+    addresses_cached_ = true;
+  }
   auto self = weak_factory_.GetWeakPtr();
   // Notifies the visitor that |this| reader gets a new packet, which may delete
   // |this| if |this| is a connectivity probing reader.
-  return visitor_->OnPacket(packet, ToQuicSocketAddress(local_address),
-                            ToQuicSocketAddress(peer_address)) &&
-         self;
+  return visitor_->OnPacket(packet, local_address_, peer_address_) && self;
 }
 
 void QuicChromiumPacketReader::OnReadComplete(int result) {
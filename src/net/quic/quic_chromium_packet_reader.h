@@ -57,10 +57,24 @@ class NET_EXPORT_PRIVATE QuicChromiumPacketReader {
   void StartReading();
 
  private:
+  // Slots filled at once by a batched read, each holding one datagram, or
+  // many with receive coalescing.
+  static constexpr int kMaxPacketsPerRead = 16;
+  static constexpr int kMaxCoalescedReadsPerRead = 2;
+
   // A completion callback invoked when a read completes.
   void OnReadComplete(int result);
   // Return true if reading should continue.
   bool ProcessReadResult(int result);
+  // Same as above for a batched read filling |result| slots. Coalesced
+  // datagrams are split up by their segment size.
+  bool ProcessReadMultipleResult(int result);
+  // Returns how many datagrams a batched read filling |result| slots holds,
+  // counting each coalesced datagram.
+  int CountDatagrams(int result) const;
+  // Hands one datagram, or the read error in |result|, to the visitor.
+  // Returns true if reading should continue.
+  bool ProcessPacket(const char* data, int result, quic::QuicTime now);
 
   raw_ptr<DatagramClientSocket> socket_;
 
@@ -71,7 +85,21 @@ class NET_EXPORT_PRIVATE QuicChromiumPacketReader {
   int yield_after_packets_;
   quic::QuicTime::Delta yield_after_duration_;
   quic::QuicTime yield_after_;
+  // Has room for |read_num_slots_| slots of |read_slot_size_| bytes, which
+  // are large enough for a coalesced read if the socket coalesces. Unbatched
+  // reads use the first slot.
   scoped_refptr<IOBufferWithSize> read_buffer_;
+  int read_slot_size_;
+  int read_num_slots_;
+  // Whether to try DatagramClientSocket::ReadMultiple(). Cleared once the
+  // socket reports that it cannot batch reads.
+  bool read_multiple_;
+  int read_lengths_[kMaxPacketsPerRead];
+  int read_segment_sizes_[kMaxPacketsPerRead];
+  // The socket is connected, so its addresses are looked up once.
+  bool addresses_cached_;
+  quic::QuicSocketAddress local_address_;
+  quic::QuicSocketAddress peer_address_;
   NetLogWithSource net_log_;
 
   base::WeakPtrFactory<QuicChromiumPacketReader> weak_factory_{this};
@@ -4,6 +4,8 @@
 
 #include "net/quic/quic_chromium_packet_writer.h"
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <utility>
 
@@ -93,6 +95,11 @@ QuicChromiumPacketWriter::QuicChromiumPacketWriter(
       write_in_progress_(false),
       force_write_blocked_(false),
       retry_count_(0) {
+  if (socket_->SupportsWriteMultiple()) {
+    batch_writes_ = true;
+    batch_ = base::MakeRefCounted<IOBuffer>(kMaxBatchPackets *
+                                            quic::kMaxOutgoingPacketSize);
+  }
   retry_timer_.SetTaskRunner(task_runner);
   write_callback_ = base::BindRepeating(
       &QuicChromiumPacketWriter::OnWriteComplete, weak_factory_.GetWeakPtr());
@@ -132,13 +139,57 @@ quic::WriteResult QuicChromiumPacketWriter::WritePacket(
     const quic::QuicSocketAddress& peer_address,
     quic::PerPacketOptions* /*options*/) {
   DCHECK(!IsWriteBlocked());
+  if (batch_writes_)
+    return BatchPacket(buffer, buf_len);
   SetPacket(buffer, buf_len);
   return WritePacketToSocketImpl();
 }
 
+quic::WriteResult QuicChromiumPacketWriter::BatchPacket(const char* buffer,
+                                                        size_t buf_len) {
+  if (buf_len > quic::kMaxOutgoingPacketSize)
+    return quic::WriteResult(quic::WRITE_STATUS_MSG_TOO_BIG, ERR_MSG_TOO_BIG);
+  DCHECK_LT(batch_num_packets_, kMaxBatchPackets);
+  std::memcpy(batch_->data() + batch_size_, buffer, buf_len);
+  batch_lengths_[batch_num_packets_++] = static_cast<int>(buf_len);
+  batch_size_ += static_cast<int>(buf_len);
+  if (batch_num_packets_ < kMaxBatchPackets)
+    return quic::WriteResult(quic::WRITE_STATUS_OK, 0);
+  return WritePacketToSocketImpl();
+}
+
+void QuicChromiumPacketWriter::TakeLastBatchedPacket() {
+  DCHECK_GT(batch_num_packets_, 0);
+  int last_length = batch_lengths_[batch_num_packets_ - 1];
+  SetPacket(batch_->data() + batch_size_ - last_length, last_length);
+  ClearBatch();
+}
+
+void QuicChromiumPacketWriter::DropWrittenBatchPackets(int bytes_written) {
+  int num_written = 0;
+  int size_written = 0;
+  while (size_written < bytes_written)
+    size_written += batch_lengths_[num_written++];
+  DCHECK_EQ(size_written, bytes_written);
+  DCHECK_LT(num_written, batch_num_packets_);
+  batch_num_packets_ -= num_written;
+  batch_size_ -= bytes_written;
+  std::memmove(batch_->data(), batch_->data() + bytes_written, batch_size_);
+  std::copy(batch_lengths_ + num_written,
+            batch_lengths_ + num_written + batch_num_packets_, batch_lengths_);
+}
+
+void QuicChromiumPacketWriter::ClearBatch() {
+  batch_num_packets_ = 0;
+  batch_size_ = 0;
+}
+
 void QuicChromiumPacketWriter::WritePacketToSocket(
     scoped_refptr<ReusableIOBuffer> packet) {
   DCHECK(!force_write_blocked_);
+  // The writer is force blocked until the packet is rewritten, so nothing
+  // can have been batched.
+  DCHECK_EQ(batch_num_packets_, 0);
   packet_ = std::move(packet);
   quic::WriteResult result = WritePacketToSocketImpl();
   if (result.error_code != ERR_IO_PENDING)
@@ -148,20 +199,40 @@ void QuicChromiumPacketWriter::WritePacketToSocket(
 quic::WriteResult QuicChromiumPacketWriter::WritePacketToSocketImpl() {
   base::TimeTicks now = base::TimeTicks::Now();
 
-  int rv = socket_->Write(packet_.get(), packet_->size(), write_callback_,
-                          kTrafficAnnotation);
+  int rv;
+  if (batch_num_packets_ > 0) {
+    rv = socket_->WriteMultiple(batch_.get(), batch_lengths_,
+                                batch_num_packets_, write_callback_,
+                                kTrafficAnnotation);
+    // A short write means a packet failed after earlier ones were sent.
+    // Writing the rest again surfaces the error for the unsent packets only.
+    while (rv > 0 && rv < batch_size_) {
+      DropWrittenBatchPackets(rv);
+      rv = socket_->WriteMultiple(batch_.get(), batch_lengths_,
+                                  batch_num_packets_, write_callback_,
+                                  kTrafficAnnotation);
+    }
+  } else {
+    rv = socket_->Write(packet_.get(), packet_->size(), write_callback_,
+                        kTrafficAnnotation);
+  }
 
   if (MaybeRetryAfterWriteError(rv))
     return quic::WriteResult(quic::WRITE_STATUS_BLOCKED_DATA_BUFFERED,
                              ERR_IO_PENDING);
 
   if (rv < 0 && rv != ERR_IO_PENDING && delegate_ != nullptr) {
+    // Earlier packets of a failed batch are left to loss recovery.
+    if (batch_num_packets_ > 0)
+      TakeLastBatchedPacket();
     // If write error, then call delegate's HandleWriteError, which
     // may be able to migrate and rewrite packet on a new socket.
     // HandleWriteError returns the outcome of that rewrite attempt.
     rv = delegate_->HandleWriteError(rv, std::move(packet_));
     DCHECK(packet_ == nullptr);
   }
+  if (rv != ERR_IO_PENDING)
+    ClearBatch();
 
   quic::WriteStatus status = quic::WRITE_STATUS_OK;
   if (rv < 0) {
@@ -201,13 +272,28 @@ void QuicChromiumPacketWriter::SetWritable() {
 void QuicChromiumPacketWriter::OnWriteComplete(int rv) {
   DCHECK_NE(rv, ERR_IO_PENDING);
   write_in_progress_ = false;
-  if (delegate_ == nullptr)
+  if (delegate_ == nullptr) {
+    ClearBatch();
     return;
+  }
+
+  if (rv > 0 && rv < batch_size_) {
+    // Part of the batch was sent before a packet failed. Only the unsent
+    // packets are written again.
+    DropWrittenBatchPackets(rv);
+    quic::WriteResult result = WritePacketToSocketImpl();
+    if (result.error_code != ERR_IO_PENDING)
+      OnWriteComplete(result.error_code);
+    return;
+  }
 
   if (rv < 0) {
     if (MaybeRetryAfterWriteError(rv))
       return;
 
+    if (batch_num_packets_ > 0)
+      TakeLastBatchedPacket();
+
     // If write error, then call delegate's HandleWriteError, which
     // may be able to migrate and rewrite packet on a new socket.
     // HandleWriteError returns the outcome of that rewrite attempt.
@@ -221,6 +307,7 @@ void QuicChromiumPacketWriter::OnWriteComplete(int rv) {
       return;
     }
   }
+  ClearBatch();
   if (retry_count_ != 0) {
     RecordRetryCount(retry_count_);
     retry_count_ = 0;
@@ -260,7 +347,7 @@ bool QuicChromiumPacketWriter::SupportsReleaseTime() const {
 }
 
 bool QuicChromiumPacketWriter::IsBatchMode() const {
-  return false;
+  return batch_writes_;
 }
 
 quic::QuicPacketBuffer QuicChromiumPacketWriter::GetNextWriteLocation(
@@ -270,7 +357,16 @@ quic::QuicPacketBuffer QuicChromiumPacketWriter::GetNextWriteLocation(
 }
 
 quic::WriteResult QuicChromiumPacketWriter::Flush() {
-  return quic::WriteResult(quic::WRITE_STATUS_OK, 0);
+  if (batch_num_packets_ == 0)
+    return quic::WriteResult(quic::WRITE_STATUS_OK, 0);
+  if (IsWriteBlocked())
+    return quic::WriteResult(quic::WRITE_STATUS_BLOCKED, ERR_IO_PENDING);
+  quic::WriteResult result = WritePacketToSocketImpl();
+  // The batch is kept until its write completes, but Flush() reports a
+  // pending write as blocked.
+  if (result.status == quic::WRITE_STATUS_BLOCKED_DATA_BUFFERED)
+    result.status = quic::WRITE_STATUS_BLOCKED;
+  return result;
 }
 
 }  // namespace net
@@ -65,8 +65,12 @@ class NET_EXPORT_PRIVATE QuicChromiumPacketWriter
     virtual void OnWriteUnblocked() = 0;
   };
 
+  // Most packets buffered before a batch is written to the socket.
+  static constexpr int kMaxBatchPackets = 32;
+
   QuicChromiumPacketWriter();
-  // |socket| and |task_runner| must outlive writer.
+  // |socket| and |task_runner| must outlive writer. Packets are batched if
+  // |socket| supports DatagramClientSocket::WriteMultiple().
   QuicChromiumPacketWriter(DatagramClientSocket* socket,
                            base::SequencedTaskRunner* task_runner);
 
@@ -107,6 +111,15 @@ class NET_EXPORT_PRIVATE QuicChromiumPacketWriter
 
  private:
   void SetPacket(const char* buffer, size_t buf_len);
+  // Appends a packet to the batch, and writes the batch once it is full.
+  quic::WriteResult BatchPacket(const char* buffer, size_t buf_len);
+  // Moves the last packet of a failed batch to |packet_|, so that the
+  // delegate may rewrite it, and drops the rest of the batch.
+  void TakeLastBatchedPacket();
+  // Drops the packets covered by a short batch write of |bytes_written|,
+  // keeping the unsent ones to be written again.
+  void DropWrittenBatchPackets(int bytes_written);
+  void ClearBatch();
   bool MaybeRetryAfterWriteError(int rv);
   void RetryPacketAfterNoBuffers();
   quic::WriteResult WritePacketToSocketImpl();
@@ -129,6 +142,15 @@ class NET_EXPORT_PRIVATE QuicChromiumPacketWriter
   // Timer set when a packet should be retried after ENOBUFS.
   base::OneShotTimer retry_timer_;
 
+  // In batch mode, packets are copied back to back into |batch_| and
+  // written with one WriteMultiple() on Flush() or when |kMaxBatchPackets|
+  // are buffered. A batch stays in place while its write is in progress.
+  bool batch_writes_ = false;
+  scoped_refptr<IOBuffer> batch_;
+  int batch_lengths_[kMaxBatchPackets];
+  int batch_num_packets_ = 0;
+  int batch_size_ = 0;
+
   CompletionRepeatingCallback write_callback_;
   base::WeakPtrFactory<QuicChromiumPacketWriter> weak_factory_{this};
 };
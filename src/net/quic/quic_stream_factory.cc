@@ -1758,6 +1758,14 @@ bool QuicStreamFactory::HasActiveSession(
   return base::Contains(active_sessions_, session_key);
 }
 
+QuicChromiumClientSession* QuicStreamFactory::FindActiveSession(
+    const QuicSessionKey& session_key) const {
+  auto it = active_sessions_.find(session_key);
+  if (it == active_sessions_.end())
+    return nullptr;
+  return it->second;
+}
+
 bool QuicStreamFactory::HasActiveJob(const QuicSessionKey& session_key) const {
   return base::Contains(active_jobs_, session_key);
 }
@@ -299,6 +299,13 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
 
   std::unique_ptr<base::Value> QuicStreamFactoryInfoToValue() const;
 
+  // Returns the number of sessions, including those going away.
+  size_t num_sessions() const { return all_sessions_.size(); }
+
+  // Returns the active session for exactly |session_key|, or nullptr.
+  QuicChromiumClientSession* FindActiveSession(
+      const QuicSessionKey& session_key) const;
+
   // Delete cached state objects in |crypto_config_|. If |origin_filter| is not
   // null, only objects on matching origins will be deleted.
   void ClearCachedStatesInCryptoConfig(
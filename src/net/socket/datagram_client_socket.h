@@ -6,6 +6,7 @@
 #define NET_SOCKET_DATAGRAM_CLIENT_SOCKET_H_
 
 #include "net/base/datagram_buffer.h"
+#include "net/base/net_errors.h"
 #include "net/base/net_export.h"
 #include "net/base/network_change_notifier.h"
 #include "net/socket/datagram_socket.h"
@@ -50,6 +51,43 @@ class NET_EXPORT_PRIVATE DatagramClientSocket : public DatagramSocket,
   // By default, this method is no-op.
   virtual void EnableRecvOptimization() {}
 
+  // Reads up to |max_packets| datagrams at once, each into its own
+  // |packet_len| byte slot of |buf|, storing their lengths in |lengths| and
+  // the size of the datagrams coalesced into each slot in |segment_sizes|.
+  // Returns the number of slots filled or a net error code. Returns
+  // ERR_NOT_IMPLEMENTED if the socket cannot batch reads, in which case
+  // Read() should be used instead. See UDPSocketPosix::ReadMultiple().
+  virtual int ReadMultiple(IOBuffer* buf,
+                           int packet_len,
+                           int max_packets,
+                           int* lengths,
+                           int* segment_sizes,
+                           CompletionOnceCallback callback) {
+    return ERR_NOT_IMPLEMENTED;
+  }
+
+  // Lets ReadMultiple() return several datagrams coalesced into one slot.
+  // Returns a net error code, ERR_NOT_IMPLEMENTED if unsupported. See
+  // UDPSocketPosix::EnableReceiveCoalescing().
+  virtual int EnableReceiveCoalescing() { return ERR_NOT_IMPLEMENTED; }
+
+  // Whether WriteMultiple() may be used on this connected socket.
+  virtual bool SupportsWriteMultiple() const { return false; }
+
+  // Writes |num_packets| datagrams stored back to back in |buf|, datagram i
+  // being |lengths[i]| bytes long. Returns the number of bytes written, which
+  // is short if a datagram failed after earlier ones were written, or a net
+  // error code. Must only be called if SupportsWriteMultiple() is true. See
+  // UDPSocketPosix::WriteMultiple().
+  virtual int WriteMultiple(
+      IOBuffer* buf,
+      const int* lengths,
+      int num_packets,
+      CompletionOnceCallback callback,
+      const NetworkTrafficAnnotationTag& traffic_annotation) {
+    return ERR_NOT_IMPLEMENTED;
+  }
+
   // As Write, but internally this can delay writes and batch them up
   // for writing in a separate task.  This is to increase throughput
   // in bulk transfer scenarios (in QUIC) where a substantial
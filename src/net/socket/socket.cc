@@ -20,6 +20,12 @@ int Socket::ReadIfReady(IOBuffer* buf,
   return ERR_READ_IF_READY_NOT_IMPLEMENTED;
 }
 
+int Socket::ReadBufferIfReady(scoped_refptr<IOBuffer>* buf,
+                              int buf_len,
+                              CompletionOnceCallback callback) {
+  return ERR_READ_IF_READY_NOT_IMPLEMENTED;
+}
+
 int Socket::CancelReadIfReady() {
   return ERR_READ_IF_READY_NOT_IMPLEMENTED;
 }
@@ -10,6 +10,7 @@
 #include <set>
 #include <string>
 
+#include "base/memory/scoped_refptr.h"
 #include "net/base/completion_once_callback.h"
 #include "net/base/net_export.h"
 #include "net/traffic_annotation/network_traffic_annotation.h"
@@ -52,6 +53,16 @@ class NET_EXPORT Socket {
                           int buf_len,
                           CompletionOnceCallback callback);
 
+  // Like ReadIfReady(), but for sockets that already hold received data in
+  // ref-counted buffers: instead of copying up to |buf_len| bytes into a
+  // caller buffer, sets |buf| to a buffer referencing them. The caller may
+  // read but must not modify the data. Default implementation returns
+  // ERR_READ_IF_READY_NOT_IMPLEMENTED. A pending call is canceled with
+  // CancelReadIfReady().
+  virtual int ReadBufferIfReady(scoped_refptr<IOBuffer>* buf,
+                                int buf_len,
+                                CompletionOnceCallback callback);
+
   // Cancels a pending ReadIfReady(). May only be called when a ReadIfReady() is
   // pending. Returns net::OK or an error code. ERR_READ_IF_READY_NOT_SUPPORTED
   // is returned if ReadIfReady() is not supported.
@@ -55,6 +55,17 @@ int SetReuseAddr(SocketDescriptor fd, bool reuse) {
   return rv == -1 ? MapSystemError(errno) : OK;
 }
 
+int SetReusePort(SocketDescriptor fd, bool reuse) {
+#if (BUILDFLAG(IS_POSIX) || BUILDFLAG(IS_FUCHSIA)) && defined(SO_REUSEPORT)
+  int boolean_value = reuse ? 1 : 0;
+  int rv = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &boolean_value,
+                      sizeof(boolean_value));
+  return rv == -1 ? MapSystemError(errno) : OK;
+#else
+  return ERR_NOT_IMPLEMENTED;
+#endif
+}
+
 int SetSocketReceiveBufferSize(SocketDescriptor fd, int32_t size) {
   int rv = setsockopt(fd, SOL_SOCKET, SO_RCVBUF,
                       reinterpret_cast<const char*>(&size), sizeof(size));
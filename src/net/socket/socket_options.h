@@ -49,6 +49,13 @@ int SetTCPNoDelay(SocketDescriptor fd, bool no_delay);
 // disable it. On error returns a net error code, on success returns OK.
 int SetReuseAddr(SocketDescriptor fd, bool reuse);
 
+// SetReusePort() sets the SO_REUSEPORT socket option, which lets several
+// listening sockets bind to the same address and have the kernel distribute
+// incoming connections among them. Returns ERR_NOT_IMPLEMENTED on platforms
+// without SO_REUSEPORT. On error returns a net error code, on success returns
+// OK.
+int SetReusePort(SocketDescriptor fd, bool reuse);
+
 // SetSocketReceiveBufferSize() sets the SO_RCVBUF socket option. On error
 // returns a net error code, on success returns OK.
 int SetSocketReceiveBufferSize(SocketDescriptor fd, int32_t size);
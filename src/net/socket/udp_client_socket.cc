@@ -89,6 +89,28 @@ int UDPClientSocket::Read(IOBuffer* buf,
   return socket_.Read(buf, buf_len, std::move(callback));
 }
 
+int UDPClientSocket::ReadMultiple(IOBuffer* buf,
+                                  int packet_len,
+                                  int max_packets,
+                                  int* lengths,
+                                  int* segment_sizes,
+                                  CompletionOnceCallback callback) {
+#if BUILDFLAG(IS_POSIX)
+  return socket_.ReadMultiple(buf, packet_len, max_packets, lengths,
+                              segment_sizes, std::move(callback));
+#else
+  return ERR_NOT_IMPLEMENTED;
+#endif
+}
+
+int UDPClientSocket::EnableReceiveCoalescing() {
+#if BUILDFLAG(IS_POSIX)
+  return socket_.EnableReceiveCoalescing();
+#else
+  return ERR_NOT_IMPLEMENTED;
+#endif
+}
+
 int UDPClientSocket::Write(
     IOBuffer* buf,
     int buf_len,
@@ -97,6 +119,28 @@ int UDPClientSocket::Write(
   return socket_.Write(buf, buf_len, std::move(callback), traffic_annotation);
 }
 
+bool UDPClientSocket::SupportsWriteMultiple() const {
+#if BUILDFLAG(IS_POSIX)
+  return true;
+#else
+  return false;
+#endif
+}
+
+int UDPClientSocket::WriteMultiple(
+    IOBuffer* buf,
+    const int* lengths,
+    int num_packets,
+    CompletionOnceCallback callback,
+    const NetworkTrafficAnnotationTag& traffic_annotation) {
+#if BUILDFLAG(IS_POSIX)
+  return socket_.WriteMultiple(buf, lengths, num_packets, std::move(callback),
+                               traffic_annotation);
+#else
+  return ERR_NOT_IMPLEMENTED;
+#endif
+}
+
 int UDPClientSocket::WriteAsync(
     const char* buffer,
     size_t buf_len,
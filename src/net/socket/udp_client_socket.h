@@ -44,10 +44,24 @@ class NET_EXPORT_PRIVATE UDPClientSocket : public DatagramClientSocket {
   int Read(IOBuffer* buf,
            int buf_len,
            CompletionOnceCallback callback) override;
+  int ReadMultiple(IOBuffer* buf,
+                   int packet_len,
+                   int max_packets,
+                   int* lengths,
+                   int* segment_sizes,
+                   CompletionOnceCallback callback) override;
+  int EnableReceiveCoalescing() override;
   int Write(IOBuffer* buf,
             int buf_len,
             CompletionOnceCallback callback,
             const NetworkTrafficAnnotationTag& traffic_annotation) override;
+  bool SupportsWriteMultiple() const override;
+  int WriteMultiple(
+      IOBuffer* buf,
+      const int* lengths,
+      int num_packets,
+      CompletionOnceCallback callback,
+      const NetworkTrafficAnnotationTag& traffic_annotation) override;
 
   int WriteAsync(
       const char* buffer,
@@ -12,6 +12,7 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 
+#include <algorithm>
 #include <memory>
 
 #include "base/bind.h"
@@ -57,6 +58,16 @@
 #include "net/android/radio_activity_tracker.h"
 #endif  // BUILDFLAG(IS_ANDROID)
 
+#if HAVE_SENDMMSG || HAVE_RECVMMSG
+#include <netinet/udp.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif  // HAVE_SENDMMSG || HAVE_RECVMMSG
+
 #if BUILDFLAG(IS_APPLE) && !BUILDFLAG(CRONET_BUILD)
 // This was needed to debug crbug.com/640281.
 // TODO(zhongyi): Remove once the bug is resolved.
@@ -74,6 +85,16 @@ const int kPortEnd = 65535;
 const int kActivityMonitorBytesThreshold = 65535;
 const int kActivityMonitorMinimumSamplesForThroughputEstimate = 2;
 const base::TimeDelta kActivityMonitorMsThreshold = base::Milliseconds(100);
+// Upper bound on the datagrams read by one ReadMultiple().
+const int kReadMultipleMaxPackets = 64;
+#if HAVE_SENDMMSG
+// Upper bound on the messages passed to one sendmmsg().
+const int kSendmmsgMaxMessages = 64;
+// Limits of the kernel on one UDP_SEGMENT message, with headroom for the IP
+// and UDP headers.
+const int kUdpSegmentMaxSegments = 64;
+const int kUdpSegmentMaxBytes = 64000;
+#endif  // HAVE_SENDMMSG
 
 #if BUILDFLAG(IS_APPLE) && !BUILDFLAG(CRONET_BUILD)
 
@@ -172,7 +193,15 @@ UDPSocketPosix::UDPSocketPosix(DatagramSocket::BindType bind_type,
       write_async_outstanding_(0),
       read_buf_len_(0),
       recv_from_address_(nullptr),
+      read_max_packets_(0),
+      read_lengths_(nullptr),
+      read_segment_sizes_(nullptr),
+      receive_coalescing_enabled_(false),
       write_buf_len_(0),
+      write_packets_sent_(0),
+      write_bytes_sent_(0),
+      udp_segment_checked_(false),
+      udp_segment_supported_(false),
       net_log_(NetLogWithSource::Make(net_log, NetLogSourceType::UDP_SOCKET)),
       bound_network_(NetworkChangeNotifier::kInvalidNetworkHandle),
       always_update_bytes_received_(base::FeatureList::IsEnabled(
@@ -274,10 +303,17 @@ void UDPSocketPosix::Close() {
   read_buf_len_ = 0;
   read_callback_.Reset();
   recv_from_address_ = nullptr;
+  read_max_packets_ = 0;
+  read_lengths_ = nullptr;
+  read_segment_sizes_ = nullptr;
+  receive_coalescing_enabled_ = false;
   write_buf_.reset();
   write_buf_len_ = 0;
   write_callback_.Reset();
   send_to_address_.reset();
+  write_lengths_.clear();
+  write_packets_sent_ = 0;
+  write_bytes_sent_ = 0;
 
   bool ok = read_socket_watcher_.StopWatchingFileDescriptor();
   DCHECK(ok);
@@ -396,6 +432,62 @@ int UDPSocketPosix::RecvFrom(IOBuffer* buf,
   return ERR_IO_PENDING;
 }
 
+int UDPSocketPosix::ReadMultiple(IOBuffer* buf,
+                                 int packet_len,
+                                 int max_packets,
+                                 int* lengths,
+                                 int* segment_sizes,
+                                 CompletionOnceCallback callback) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  DCHECK_NE(kInvalidSocket, socket_);
+  CHECK(read_callback_.is_null());
+  DCHECK(!callback.is_null());  // Synchronous operation not supported
+  DCHECK_GT(packet_len, 0);
+  DCHECK_GT(max_packets, 0);
+
+  if (!is_connected_ || !remote_address_)
+    return ERR_NOT_IMPLEMENTED;
+
+  max_packets = std::min(max_packets, kReadMultipleMaxPackets);
+  int result = InternalRecvMultiple(buf, packet_len, max_packets, lengths,
+                                    segment_sizes);
+  if (result != ERR_IO_PENDING)
+    return result;
+
+  if (!base::CurrentIOThread::Get()->WatchFileDescriptor(
+          socket_, true, base::MessagePumpForIO::WATCH_READ,
+          &read_socket_watcher_, &read_watcher_)) {
+    PLOG(ERROR) << "WatchFileDescriptor failed on read";
+    result = MapSystemError(errno);
+    LogRead(result, nullptr, 0, nullptr);
+    return result;
+  }
+
+  read_buf_ = buf;
+  read_buf_len_ = packet_len;
+  read_max_packets_ = max_packets;
+  read_lengths_ = lengths;
+  read_segment_sizes_ = segment_sizes;
+  read_callback_ = std::move(callback);
+  return ERR_IO_PENDING;
+}
+
+int UDPSocketPosix::EnableReceiveCoalescing() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  DCHECK_NE(kInvalidSocket, socket_);
+#if HAVE_RECVMMSG
+  if (!is_connected_ || !remote_address_)
+    return ERR_NOT_IMPLEMENTED;
+  int value = 1;
+  if (setsockopt(socket_, IPPROTO_UDP, UDP_GRO, &value, sizeof(value)) != 0)
+    return MapSystemError(errno);
+  receive_coalescing_enabled_ = true;
+  return OK;
+#else
+  return ERR_NOT_IMPLEMENTED;
+#endif  // HAVE_RECVMMSG
+}
+
 int UDPSocketPosix::Write(
     IOBuffer* buf,
     int buf_len,
@@ -447,6 +539,46 @@ int UDPSocketPosix::SendToOrWrite(IOBuffer* buf,
   return ERR_IO_PENDING;
 }
 
+int UDPSocketPosix::WriteMultiple(
+    IOBuffer* buf,
+    const int* lengths,
+    int num_packets,
+    CompletionOnceCallback callback,
+    const NetworkTrafficAnnotationTag& traffic_annotation) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  DCHECK_NE(kInvalidSocket, socket_);
+  DCHECK(is_connected_);
+  CHECK(write_callback_.is_null());
+  DCHECK(!callback.is_null());  // Synchronous operation not supported
+  DCHECK_GT(num_packets, 0);
+#if BUILDFLAG(IS_ANDROID)
+  android::MaybeRecordUDPWriteForWakeupTrigger(traffic_annotation);
+#endif  // BUILDFLAG(IS_ANDROID)
+
+  int packets_sent = 0;
+  int bytes_sent = 0;
+  int result = InternalSendMultiple(buf, lengths, num_packets, &packets_sent,
+                                    &bytes_sent);
+  if (result != ERR_IO_PENDING)
+    return result;
+
+  if (!base::CurrentIOThread::Get()->WatchFileDescriptor(
+          socket_, true, base::MessagePumpForIO::WATCH_WRITE,
+          &write_socket_watcher_, &write_watcher_)) {
+    DVPLOG(1) << "WatchFileDescriptor failed on write";
+    result = MapSystemError(errno);
+    LogWrite(result, nullptr, nullptr);
+    return result;
+  }
+
+  write_buf_ = buf;
+  write_lengths_.assign(lengths, lengths + num_packets);
+  write_packets_sent_ = packets_sent;
+  write_bytes_sent_ = bytes_sent;
+  write_callback_ = std::move(callback);
+  return ERR_IO_PENDING;
+}
+
 int UDPSocketPosix::Connect(const IPEndPoint& address) {
   DCHECK_NE(socket_, kInvalidSocket);
   net_log_.BeginEvent(NetLogEventType::UDP_CONNECT, [&] {
@@ -666,12 +798,22 @@ void UDPSocketPosix::DoWriteCallback(int rv) {
 }
 
 void UDPSocketPosix::DidCompleteRead() {
-  int result =
-      InternalRecvFrom(read_buf_.get(), read_buf_len_, recv_from_address_);
+  int result;
+  if (read_lengths_) {
+    result = InternalRecvMultiple(read_buf_.get(), read_buf_len_,
+                                  read_max_packets_, read_lengths_,
+                                  read_segment_sizes_);
+  } else {
+    result =
+        InternalRecvFrom(read_buf_.get(), read_buf_len_, recv_from_address_);
+  }
   if (result != ERR_IO_PENDING) {
     read_buf_.reset();
     read_buf_len_ = 0;
     recv_from_address_ = nullptr;
+    read_max_packets_ = 0;
+    read_lengths_ = nullptr;
+    read_segment_sizes_ = nullptr;
     bool ok = read_socket_watcher_.StopWatchingFileDescriptor();
     DCHECK(ok);
     DoReadCallback(result);
@@ -705,13 +847,24 @@ void UDPSocketPosix::LogRead(int result,
 }
 
 void UDPSocketPosix::DidCompleteWrite() {
-  int result =
-      InternalSendTo(write_buf_.get(), write_buf_len_, send_to_address_.get());
+  int result;
+  if (!write_lengths_.empty()) {
+    result = InternalSendMultiple(
+        write_buf_.get(), write_lengths_.data(),
+        static_cast<int>(write_lengths_.size()), &write_packets_sent_,
+        &write_bytes_sent_);
+  } else {
+    result = InternalSendTo(write_buf_.get(), write_buf_len_,
+                            send_to_address_.get());
+  }
 
   if (result != ERR_IO_PENDING) {
     write_buf_.reset();
     write_buf_len_ = 0;
     send_to_address_.reset();
+    write_lengths_.clear();
+    write_packets_sent_ = 0;
+    write_bytes_sent_ = 0;
     write_socket_watcher_.StopWatchingFileDescriptor();
     DoWriteCallback(result);
   }
@@ -813,6 +966,72 @@ int UDPSocketPosix::InternalRecvFromNonConnectedSocket(IOBuffer* buf,
   return result;
 }
 
+int UDPSocketPosix::InternalRecvMultiple(IOBuffer* buf,
+                                         int packet_len,
+                                         int max_packets,
+                                         int* lengths,
+                                         int* segment_sizes) {
+#if HAVE_RECVMMSG
+  DCHECK(is_connected_);
+  DCHECK(remote_address_);
+  DCHECK_LE(max_packets, kReadMultipleMaxPackets);
+  struct iovec iov[kReadMultipleMaxPackets];
+  struct mmsghdr msgvec[kReadMultipleMaxPackets];
+  alignas(struct cmsghdr) char
+      control[kReadMultipleMaxPackets][CMSG_SPACE(sizeof(int))];
+  for (int i = 0; i < max_packets; ++i) {
+    iov[i].iov_base = buf->data() + i * packet_len;
+    iov[i].iov_len = static_cast<size_t>(packet_len);
+    msgvec[i] = {};
+    msgvec[i].msg_hdr.msg_iov = &iov[i];
+    msgvec[i].msg_hdr.msg_iovlen = 1;
+    if (receive_coalescing_enabled_) {
+      msgvec[i].msg_hdr.msg_control = control[i];
+      msgvec[i].msg_hdr.msg_controllen = sizeof(control[i]);
+    }
+  }
+  int result =
+      HANDLE_EINTR(recvmmsg(socket_, msgvec, max_packets, 0, nullptr));
+  if (result < 0) {
+    result = MapSystemError(errno);
+    if (result != ERR_IO_PENDING)
+      LogRead(result, nullptr, 0, nullptr);
+    return result;
+  }
+
+  // The socket is connected, so every datagram comes from |remote_address_|.
+  SockaddrStorage sock_addr;
+  bool success =
+      remote_address_->ToSockAddr(sock_addr.addr, &sock_addr.addr_len);
+  DCHECK(success);
+  for (int i = 0; i < result; ++i) {
+    if (msgvec[i].msg_hdr.msg_flags & MSG_TRUNC) {
+      lengths[i] = ERR_MSG_TOO_BIG;
+    } else {
+      lengths[i] = static_cast<int>(msgvec[i].msg_len);
+    }
+    segment_sizes[i] = lengths[i];
+    if (receive_coalescing_enabled_) {
+      // Coalesced datagrams carry their size in a UDP_GRO message.
+      for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msgvec[i].msg_hdr); cmsg;
+           cmsg = CMSG_NXTHDR(&msgvec[i].msg_hdr, cmsg)) {
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+          int segment_size;
+          memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+          if (segment_size > 0 && lengths[i] > 0)
+            segment_sizes[i] = segment_size;
+        }
+      }
+    }
+    LogRead(lengths[i], static_cast<const char*>(iov[i].iov_base),
+            sock_addr.addr_len, sock_addr.addr);
+  }
+  return result;
+#else
+  return ERR_NOT_IMPLEMENTED;
+#endif  // HAVE_RECVMMSG
+}
+
 int UDPSocketPosix::InternalSendTo(IOBuffer* buf,
                                    int buf_len,
                                    const IPEndPoint* address) {
@@ -838,6 +1057,115 @@ int UDPSocketPosix::InternalSendTo(IOBuffer* buf,
   return result;
 }
 
+int UDPSocketPosix::InternalSendMultiple(IOBuffer* buf,
+                                         const int* lengths,
+                                         int num_packets,
+                                         int* packets_sent,
+                                         int* bytes_sent) {
+#if HAVE_SENDMMSG
+  while (*packets_sent < num_packets) {
+    bool use_udp_segment = IsUdpSegmentSupported();
+    struct iovec iov[kSendmmsgMaxMessages];
+    struct mmsghdr msgvec[kSendmmsgMaxMessages];
+    int message_packets[kSendmmsgMaxMessages];
+    alignas(struct cmsghdr) char
+        control[kSendmmsgMaxMessages][CMSG_SPACE(sizeof(uint16_t))];
+    int num_messages = 0;
+    int packet = *packets_sent;
+    int offset = *bytes_sent;
+    while (packet < num_packets && num_messages < kSendmmsgMaxMessages) {
+      // A message carries a run of datagrams of the same size, except that
+      // the last one may be shorter.
+      int segment_size = lengths[packet];
+      int count = 1;
+      int message_size = segment_size;
+      while (use_udp_segment && packet + count < num_packets &&
+             count < kUdpSegmentMaxSegments &&
+             lengths[packet + count - 1] == segment_size &&
+             lengths[packet + count] <= segment_size &&
+             message_size + lengths[packet + count] <= kUdpSegmentMaxBytes) {
+        message_size += lengths[packet + count];
+        ++count;
+      }
+
+      iov[num_messages].iov_base = buf->data() + offset;
+      iov[num_messages].iov_len = static_cast<size_t>(message_size);
+      struct mmsghdr& hdr = msgvec[num_messages];
+      hdr = {};
+      hdr.msg_hdr.msg_iov = &iov[num_messages];
+      hdr.msg_hdr.msg_iovlen = 1;
+      if (count > 1) {
+        hdr.msg_hdr.msg_control = control[num_messages];
+        hdr.msg_hdr.msg_controllen = sizeof(control[num_messages]);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr.msg_hdr);
+        cmsg->cmsg_level = IPPROTO_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t gso_size = static_cast<uint16_t>(segment_size);
+        memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+      }
+      message_packets[num_messages] = count;
+      ++num_messages;
+      packet += count;
+      offset += message_size;
+    }
+
+    int result =
+        HANDLE_EINTR(sendmmsg(socket_, msgvec, num_messages, sendto_flags_));
+    if (result < 0) {
+      // Without checksum offload on the egress device, UDP_SEGMENT fails
+      // with EIO. Send plain datagrams from then on.
+      if (errno == EIO && use_udp_segment) {
+        udp_segment_supported_ = false;
+        continue;
+      }
+      result = MapSystemError(errno);
+      if (result == ERR_IO_PENDING)
+        return result;
+      LogWrite(result, nullptr, nullptr);
+      // Report what was written, so that only the rest is sent again.
+      return *packets_sent > 0 ? *bytes_sent : result;
+    }
+    for (int i = 0; i < result; ++i) {
+      LogWrite(static_cast<int>(iov[i].iov_len),
+               static_cast<const char*>(iov[i].iov_base), nullptr);
+      *packets_sent += message_packets[i];
+      *bytes_sent += static_cast<int>(iov[i].iov_len);
+    }
+  }
+#else
+  while (*packets_sent < num_packets) {
+    int length = lengths[*packets_sent];
+    int result = HANDLE_EINTR(
+        send(socket_, buf->data() + *bytes_sent, length, sendto_flags_));
+    if (result < 0) {
+      result = MapSystemError(errno);
+      if (result == ERR_IO_PENDING)
+        return result;
+      LogWrite(result, nullptr, nullptr);
+      return *packets_sent > 0 ? *bytes_sent : result;
+    }
+    LogWrite(result, buf->data() + *bytes_sent, nullptr);
+    ++*packets_sent;
+    *bytes_sent += length;
+  }
+#endif  // HAVE_SENDMMSG
+  return *bytes_sent;
+}
+
+bool UDPSocketPosix::IsUdpSegmentSupported() {
+#if HAVE_SENDMMSG
+  if (!udp_segment_checked_) {
+    udp_segment_checked_ = true;
+    int value = 0;
+    socklen_t value_len = sizeof(value);
+    udp_segment_supported_ = getsockopt(socket_, IPPROTO_UDP, UDP_SEGMENT,
+                                        &value, &value_len) == 0;
+  }
+#endif  // HAVE_SENDMMSG
+  return udp_segment_supported_;
+}
+
 int UDPSocketPosix::SetMulticastOptions() {
   if (!(socket_options_ & SOCKET_OPTION_MULTICAST_LOOP)) {
     int rv;
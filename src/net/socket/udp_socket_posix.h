@@ -10,6 +10,7 @@
 #include <sys/types.h>
 
 #include <memory>
+#include <vector>
 
 #include "base/logging.h"
 #include "base/memory/raw_ptr.h"
@@ -41,6 +42,12 @@
 #define HAVE_SENDMMSG 0
 #endif
 
+#if BUILDFLAG(IS_LINUX) || BUILDFLAG(IS_CHROMEOS) || BUILDFLAG(IS_ANDROID)
+#define HAVE_RECVMMSG 1
+#else
+#define HAVE_RECVMMSG 0
+#endif
+
 namespace net {
 
 class IPAddress;
@@ -198,6 +205,30 @@ class NET_EXPORT UDPSocketPosix {
   // has been connected.
   int Read(IOBuffer* buf, int buf_len, CompletionOnceCallback callback);
 
+  // Reads up to |max_packets| datagrams with one system call. Datagram i is
+  // read into |buf| at offset i * |packet_len|, and its length, or
+  // ERR_MSG_TOO_BIG if it was truncated, is stored in |lengths[i]|. With
+  // receive coalescing, slot i may instead hold several datagrams of
+  // |segment_sizes[i]| bytes each, the last one possibly shorter; otherwise
+  // |segment_sizes[i]| equals |lengths[i]|. Returns the number of slots
+  // filled or a net error code. If ERR_IO_PENDING is returned, the caller
+  // must keep |lengths| and |segment_sizes| alive until the callback is
+  // called. Returns ERR_NOT_IMPLEMENTED without recvmmsg() or if the socket
+  // is not connected.
+  int ReadMultiple(IOBuffer* buf,
+                   int packet_len,
+                   int max_packets,
+                   int* lengths,
+                   int* segment_sizes,
+                   CompletionOnceCallback callback);
+
+  // Lets the kernel coalesce consecutive datagrams from the peer into one
+  // read (UDP_GRO). Reads must then use ReadMultiple() with slots of at
+  // least 64 KiB. Returns ERR_NOT_IMPLEMENTED where ReadMultiple() is
+  // unavailable, or the net error of enabling the option, e.g. on kernels
+  // before 5.0.
+  int EnableReceiveCoalescing();
+
   // Writes to the socket.
   // Only usable from the client-side of a UDP socket, after the socket
   // has been connected.
@@ -206,6 +237,22 @@ class NET_EXPORT UDPSocketPosix {
             CompletionOnceCallback callback,
             const NetworkTrafficAnnotationTag& traffic_annotation);
 
+  // Writes |num_packets| datagrams stored back to back in |buf|, datagram i
+  // being |lengths[i]| bytes long, with as few system calls as possible.
+  // Runs of equally sized datagrams are sent as one UDP_SEGMENT (GSO) message
+  // where the kernel supports it, and messages are sent with sendmmsg().
+  // Returns the number of bytes written or a net error code. If
+  // ERR_IO_PENDING is returned, the rest of the batch is written once the
+  // socket is writable; |lengths| is copied and need not outlive the call.
+  // If a datagram fails after earlier ones were written, the bytes written so
+  // far are returned, and the error surfaces when the rest is written again.
+  // Only usable after the socket has been connected.
+  int WriteMultiple(IOBuffer* buf,
+                    const int* lengths,
+                    int num_packets,
+                    CompletionOnceCallback callback,
+                    const NetworkTrafficAnnotationTag& traffic_annotation);
+
   // Refer to datagram_client_socket.h
   int WriteAsync(DatagramBuffers buffers,
                  CompletionOnceCallback callback,
@@ -524,6 +571,24 @@ class NET_EXPORT UDPSocketPosix {
                                          IPEndPoint* address);
   int InternalSendTo(IOBuffer* buf, int buf_len, const IPEndPoint* address);
 
+  // Writes the datagrams of a batch from |*packets_sent| on, advancing
+  // |*packets_sent| and |*bytes_sent|. Returns |*bytes_sent| once the batch
+  // is written, or if a send fails after some datagrams were written.
+  int InternalSendMultiple(IOBuffer* buf,
+                           const int* lengths,
+                           int num_packets,
+                           int* packets_sent,
+                           int* bytes_sent);
+  // Whether UDP_SEGMENT can be used on |socket_|. Checked on first use.
+  bool IsUdpSegmentSupported();
+
+  // Reads a batch of datagrams from a connected socket with recvmmsg().
+  int InternalRecvMultiple(IOBuffer* buf,
+                           int packet_len,
+                           int max_packets,
+                           int* lengths,
+                           int* segment_sizes);
+
   // Applies |socket_options_| to |socket_|. Should be called before
   // Bind().
   int SetMulticastOptions();
@@ -599,11 +664,26 @@ class NET_EXPORT UDPSocketPosix {
   scoped_refptr<IOBuffer> read_buf_;
   int read_buf_len_;
   raw_ptr<IPEndPoint> recv_from_address_;
+  // Set while a ReadMultiple() is pending.
+  int read_max_packets_;
+  raw_ptr<int> read_lengths_;
+  raw_ptr<int> read_segment_sizes_;
+  // Whether UDP_GRO is enabled on |socket_|.
+  bool receive_coalescing_enabled_;
 
   // The buffer used by InternalWrite() to retry Write requests
   scoped_refptr<IOBuffer> write_buf_;
   int write_buf_len_;
   std::unique_ptr<IPEndPoint> send_to_address_;
+  // Set while a WriteMultiple() is pending. The lengths are copied since the
+  // caller's array may be gone by the time the socket becomes writable.
+  std::vector<int> write_lengths_;
+  int write_packets_sent_;
+  int write_bytes_sent_;
+
+  // Whether UDP_SEGMENT support has been checked, and the result.
+  bool udp_segment_checked_;
+  bool udp_segment_supported_;
 
   // External callback; called when read is complete.
   CompletionOnceCallback read_callback_;
@@ -43,9 +43,11 @@ std::unique_ptr<spdy::SpdySerializedFrame> MakeSpdySerializedFrame(
 class SpdyBuffer::SharedFrameIOBuffer : public IOBuffer {
  public:
   SharedFrameIOBuffer(const scoped_refptr<SharedFrame>& shared_frame,
+                      const scoped_refptr<IOBuffer>& owner,
                       size_t offset)
       : IOBuffer(shared_frame->data->data() + offset),
-        shared_frame_(shared_frame) {}
+        shared_frame_(shared_frame),
+        owner_(owner) {}
 
   SharedFrameIOBuffer(const SharedFrameIOBuffer&) = delete;
   SharedFrameIOBuffer& operator=(const SharedFrameIOBuffer&) = delete;
@@ -57,6 +59,7 @@ class SpdyBuffer::SharedFrameIOBuffer : public IOBuffer {
   }
 
   const scoped_refptr<SharedFrame> shared_frame_;
+  const scoped_refptr<IOBuffer> owner_;
 };
 
 SpdyBuffer::SpdyBuffer(std::unique_ptr<spdy::SpdySerializedFrame> frame)
@@ -72,6 +75,16 @@ SpdyBuffer::SpdyBuffer(const char* data, size_t size) :
   shared_frame_->data = MakeSpdySerializedFrame(data, size);
 }
 
+SpdyBuffer::SpdyBuffer(scoped_refptr<IOBuffer> buffer,
+                       size_t offset,
+                       size_t size)
+    : shared_frame_(new SharedFrame()), owner_(std::move(buffer)), offset_(0) {
+  CHECK_GT(size, 0u);
+  CHECK_LE(size, kMaxSpdyFrameSize);
+  shared_frame_->data = std::make_unique<spdy::SpdySerializedFrame>(
+      owner_->data() + offset, size, false /* owns_buffer */);
+}
+
 SpdyBuffer::~SpdyBuffer() {
   if (GetRemainingSize() > 0)
     ConsumeHelper(GetRemainingSize(), DISCARD);
@@ -94,7 +107,8 @@ void SpdyBuffer::Consume(size_t consume_size) {
 }
 
 scoped_refptr<IOBuffer> SpdyBuffer::GetIOBufferForRemainingData() {
-  return base::MakeRefCounted<SharedFrameIOBuffer>(shared_frame_, offset_);
+  return base::MakeRefCounted<SharedFrameIOBuffer>(shared_frame_, owner_,
+                                                   offset_);
 }
 
 void SpdyBuffer::ConsumeHelper(size_t consume_size,
@@ -11,6 +11,7 @@
 
 #include "base/callback_forward.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/scoped_refptr.h"
 #include "net/base/net_export.h"
 
 namespace spdy {
@@ -55,6 +56,12 @@ class NET_EXPORT_PRIVATE SpdyBuffer {
   // non-NULL and |size| must be non-zero.
   SpdyBuffer(const char* data, size_t size);
 
+  // Construct with |size| bytes of |buffer| starting at |offset|, without
+  // copying. Holds a reference to |buffer|, which must not be modified
+  // while this object or any IOBuffer returned by
+  // GetIOBufferForRemainingData() is alive.
+  SpdyBuffer(scoped_refptr<IOBuffer> buffer, size_t offset, size_t size);
+
   SpdyBuffer(const SpdyBuffer&) = delete;
   SpdyBuffer& operator=(const SpdyBuffer&) = delete;
 
@@ -99,6 +106,8 @@ class NET_EXPORT_PRIVATE SpdyBuffer {
   class SharedFrameIOBuffer;
 
   const scoped_refptr<SharedFrame> shared_frame_;
+  // Owns the data of |shared_frame_| if it does not own it itself.
+  const scoped_refptr<IOBuffer> owner_;
   std::vector<ConsumeCallback> consume_callbacks_;
   size_t offset_;
 };
@@ -233,6 +233,32 @@ int SpdyProxyClientSocket::ReadIfReady(IOBuffer* buf,
   return result;
 }
 
+int SpdyProxyClientSocket::ReadBufferIfReady(scoped_refptr<IOBuffer>* buf,
+                                             int buf_len,
+                                             CompletionOnceCallback callback) {
+  DCHECK(!read_callback_);
+  DCHECK(!user_buffer_);
+
+  if (next_state_ == STATE_DISCONNECTED)
+    return ERR_SOCKET_NOT_CONNECTED;
+
+  if (next_state_ == STATE_CLOSED && read_buffer_queue_.IsEmpty()) {
+    return 0;
+  }
+
+  DCHECK(next_state_ == STATE_OPEN || next_state_ == STATE_CLOSED);
+  DCHECK(buf);
+  DCHECK_GT(buf_len, 0);
+  // The received DATA payloads are handed out as they are, usually as slices
+  // of the session's read buffer.
+  size_t result = read_buffer_queue_.DequeueBuffer(buf, buf_len);
+  if (result == 0) {
+    read_callback_ = std::move(callback);
+    return ERR_IO_PENDING;
+  }
+  return result;
+}
+
 int SpdyProxyClientSocket::CancelReadIfReady() {
   // Only a pending ReadIfReady() can be canceled.
   DCHECK(!user_buffer_) << "Pending Read() cannot be canceled";
@@ -89,6 +89,9 @@ class NET_EXPORT_PRIVATE SpdyProxyClientSocket : public ProxyClientSocket,
   int ReadIfReady(IOBuffer* buf,
                   int buf_len,
                   CompletionOnceCallback callback) override;
+  int ReadBufferIfReady(scoped_refptr<IOBuffer>* buf,
+                        int buf_len,
+                        CompletionOnceCallback callback) override;
   int CancelReadIfReady() override;
   int Write(IOBuffer* buf,
             int buf_len,
@@ -8,6 +8,7 @@
 #include <utility>
 
 #include "base/check_op.h"
+#include "net/base/io_buffer.h"
 #include "net/spdy/spdy_buffer.h"
 
 namespace net {
@@ -51,6 +52,30 @@ size_t SpdyReadQueue::Dequeue(char* out, size_t len) {
   return bytes_copied;
 }
 
+size_t SpdyReadQueue::DequeueBuffer(scoped_refptr<IOBuffer>* out,
+                                    size_t len) {
+  DCHECK_GT(len, 0u);
+  if (queue_.empty())
+    return 0;
+  SpdyBuffer* buffer = queue_.front().get();
+  if (buffer->GetRemainingSize() < len && queue_.size() > 1) {
+    // Fewer, larger reads are worth one copy.
+    size_t size = std::min(len, total_size_);
+    auto gathered = base::MakeRefCounted<IOBuffer>(size);
+    size_t bytes_copied = Dequeue(gathered->data(), size);
+    *out = std::move(gathered);
+    return bytes_copied;
+  }
+  size_t bytes_dequeued = std::min(len, buffer->GetRemainingSize());
+  *out = buffer->GetIOBufferForRemainingData();
+  if (bytes_dequeued == buffer->GetRemainingSize())
+    queue_.pop_front();
+  else
+    buffer->Consume(bytes_dequeued);
+  total_size_ -= bytes_dequeued;
+  return bytes_dequeued;
+}
+
 void SpdyReadQueue::Clear() {
   queue_.clear();
   total_size_ = 0;
@@ -9,10 +9,12 @@
 #include <memory>
 
 #include "base/containers/circular_deque.h"
+#include "base/memory/scoped_refptr.h"
 #include "net/base/net_export.h"
 
 namespace net {
 
+class IOBuffer;
 class SpdyBuffer;
 
 // A FIFO queue of incoming data from a SPDY connection. Useful for
@@ -39,6 +41,12 @@ class NET_EXPORT_PRIVATE SpdyReadQueue {
   // |out|. Returns the number of bytes dequeued.
   size_t Dequeue(char* out, size_t len);
 
+  // Dequeues up to |len| (which must be positive) bytes and points |out| at
+  // them. If the first buffer in the queue has |len| bytes or is the only
+  // one, its bytes are not copied; otherwise bytes from several buffers are
+  // copied into a new buffer. Returns the number of bytes dequeued.
+  size_t DequeueBuffer(scoped_refptr<IOBuffer>* out, size_t len);
+
   // Removes all bytes from the queue.
   void Clear();
 
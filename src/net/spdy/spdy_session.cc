@@ -4,6 +4,8 @@
 
 #include "net/spdy/spdy_session.h"
 
+#include <string.h>
+
 #include <algorithm>
 #include <limits>
 #include <map>
@@ -95,9 +97,20 @@ constexpr net::NetworkTrafficAnnotationTag
         }
     )");
 
+// Reads start at kReadBufferSize and grow while they fill the buffer, up to
+// kMaxReadBufferSize.
 const int kReadBufferSize = 8 * 1024;
+const int kMaxReadBufferSize = 256 * 1024;
+// DATA payloads covering at least 1/kMaxReadBufferPinRatio of the read
+// buffer are delivered as slices of it instead of copies. Smaller ones are
+// copied, so a slice held by a slow stream pins at most kMaxReadBufferPinRatio
+// times the bytes flow control accounts for.
+const int kMaxReadBufferPinRatio = 4;
 const int kDefaultConnectionAtRiskOfLossSeconds = 10;
 const int kHungIntervalSeconds = 10;
+// Minimum time between bandwidth-delay product samples once receive windows
+// stop growing.
+const int kBdpSampleIntervalSeconds = 1;
 
 // Lifetime of unclaimed pushed stream, in seconds: after this period, a pushed
 // stream is cancelled if still not claimed.
@@ -920,6 +933,12 @@ bool SpdySession::CanPool(
   return true;
 }
 
+SpdySession::InFlightWrite::InFlightWrite() = default;
+SpdySession::InFlightWrite::InFlightWrite(InFlightWrite&&) = default;
+SpdySession::InFlightWrite& SpdySession::InFlightWrite::operator=(
+    InFlightWrite&&) = default;
+SpdySession::InFlightWrite::~InFlightWrite() = default;
+
 SpdySession::SpdySession(
     const SpdySessionKey& spdy_session_key,
     HttpServerProperties* http_server_properties,
@@ -932,6 +951,8 @@ SpdySession::SpdySession(
     bool is_quic_enabled,
     size_t session_max_recv_window_size,
     int session_max_queued_capped_frames,
+    size_t write_coalescing_size,
+    size_t recv_window_auto_tuning_limit,
     const spdy::SettingsMap& initial_settings,
     bool enable_http2_settings_grease,
     const absl::optional<SpdySessionPool::GreasedHttp2Frame>&
@@ -949,6 +970,7 @@ SpdySession::SpdySession(
       transport_security_state_(transport_security_state),
       ssl_config_service_(ssl_config_service),
       socket_(nullptr),
+      read_buffer_size_(kReadBufferSize),
       stream_hi_water_mark_(kFirstStreamId),
       last_accepted_push_stream_id_(0),
       push_delegate_(push_delegate),
@@ -956,8 +978,7 @@ SpdySession::SpdySession(
       num_active_pushed_streams_(0u),
       bytes_pushed_count_(0u),
       bytes_pushed_and_unclaimed_count_(0u),
-      in_flight_write_frame_type_(spdy::SpdyFrameType::DATA),
-      in_flight_write_frame_size_(0),
+      write_coalescing_size_(write_coalescing_size),
       availability_state_(STATE_AVAILABLE),
       read_state_(READ_STATE_DO_READ),
       write_state_(WRITE_STATE_IDLE),
@@ -992,6 +1013,11 @@ SpdySession::SpdySession(
       last_recv_window_update_(base::TimeTicks::Now()),
       time_to_buffer_small_window_updates_(
           kDefaultTimeToBufferSmallWindowUpdates),
+      recv_window_auto_tuning_limit_(static_cast<int32_t>(
+          std::min<size_t>(recv_window_auto_tuning_limit,
+                           std::numeric_limits<int32_t>::max()))),
+      bdp_ping_in_flight_(false),
+      bdp_sample_bytes_(0),
       stream_initial_send_window_size_(kDefaultInitialWindowSize),
       max_header_table_size_(
           initial_settings.at(spdy::SETTINGS_HEADER_TABLE_SIZE)),
@@ -1373,7 +1399,7 @@ std::unique_ptr<SpdyBuffer> SpdySession::CreateDataBuffer(
 
   // Obey send window size of the stream.
   if (send_stalled_by_stream) {
-    stream->set_send_stalled_by_flow_control(true);
+    stream->OnSendStalled(/*by_session=*/false);
     // Even though we're currently stalled only by the stream, we
     // might end up being stalled by the session also.
     QueueSendStalledStream(*stream);
@@ -1387,7 +1413,7 @@ std::unique_ptr<SpdyBuffer> SpdySession::CreateDataBuffer(
 
   // Obey send window size of the session.
   if (send_stalled_by_session) {
-    stream->set_send_stalled_by_flow_control(true);
+    stream->OnSendStalled(/*by_session=*/true);
     QueueSendStalledStream(*stream);
     net_log_.AddEventWithIntParams(
         NetLogEventType::HTTP2_SESSION_STREAM_STALLED_BY_SESSION_SEND_WINDOW,
@@ -2409,6 +2435,7 @@ int SpdySession::DoReadLoop(ReadState expected_read_state, int result) {
     if (read_state_ == READ_STATE_DO_READ &&
         (bytes_read_without_yielding > kYieldAfterBytesRead ||
          time_func_() > yield_after_time)) {
+      stats_.num_read_yields++;
       base::ThreadTaskRunnerHandle::Get()->PostTask(
           FROM_HERE,
           base::BindOnce(&SpdySession::PumpReadLoop, weak_factory_.GetWeakPtr(),
@@ -2425,17 +2452,21 @@ int SpdySession::DoReadLoop(ReadState expected_read_state, int result) {
 }
 
 int SpdySession::DoRead() {
-  DCHECK(!read_buffer_);
   CHECK(in_io_loop_);
 
   CHECK(socket_);
   read_state_ = READ_STATE_DO_READ_COMPLETE;
-  read_buffer_ = base::MakeRefCounted<IOBuffer>(kReadBufferSize);
+  // The buffer cannot be reused while streams still hold slices of it.
+  if (!read_buffer_ || read_buffer_->size() != read_buffer_size_ ||
+      !read_buffer_->HasOneRef()) {
+    read_buffer_ = base::MakeRefCounted<IOBufferWithSize>(read_buffer_size_);
+  }
   int rv = socket_->ReadIfReady(
-      read_buffer_.get(), kReadBufferSize,
+      read_buffer_.get(), read_buffer_->size(),
       base::BindOnce(&SpdySession::PumpReadLoop, weak_factory_.GetWeakPtr(),
                      READ_STATE_DO_READ));
   if (rv == ERR_IO_PENDING) {
+    // Idle sessions do not hold on to a read buffer.
     read_buffer_ = nullptr;
     read_state_ = READ_STATE_DO_READ;
     return rv;
@@ -2443,7 +2474,7 @@ int SpdySession::DoRead() {
   if (rv == ERR_READ_IF_READY_NOT_IMPLEMENTED) {
     // Fallback to regular Read().
     return socket_->Read(
-        read_buffer_.get(), kReadBufferSize,
+        read_buffer_.get(), read_buffer_->size(),
         base::BindOnce(&SpdySession::PumpReadLoop, weak_factory_.GetWeakPtr(),
                        READ_STATE_DO_READ_COMPLETE));
   }
@@ -2469,10 +2500,17 @@ int SpdySession::DoReadComplete(int result) {
         base::StringPrintf("Error %d reading from socket.", -result));
     return result;
   }
-  CHECK_LE(result, kReadBufferSize);
+  CHECK_LE(result, read_buffer_->size());
 
   last_read_time_ = time_func_();
 
+  // Size the next read by how full this one was.
+  if (result == read_buffer_->size()) {
+    read_buffer_size_ = std::min(read_buffer_size_ * 2, kMaxReadBufferSize);
+  } else if (result < read_buffer_->size() / 4) {
+    read_buffer_size_ = std::max(read_buffer_size_ / 2, kReadBufferSize);
+  }
+
   DCHECK(buffered_spdy_framer_.get());
   char* data = read_buffer_->data();
   while (result > 0) {
@@ -2489,7 +2527,7 @@ int SpdySession::DoReadComplete(int result) {
               http2::Http2DecoderAdapter::SPDY_NO_ERROR);
   }
 
-  read_buffer_ = nullptr;
+  // Keep |read_buffer_| for the next read.
   read_state_ = READ_STATE_DO_READ;
   return OK;
 }
@@ -2500,7 +2538,7 @@ void SpdySession::PumpWriteLoop(WriteState expected_write_state, int result) {
 
   DoWriteLoop(expected_write_state, result);
 
-  if (availability_state_ == STATE_DRAINING && !in_flight_write_ &&
+  if (availability_state_ == STATE_DRAINING && in_flight_writes_.empty() &&
       write_queue_.IsEmpty()) {
     pool_->RemoveUnavailableSession(GetWeakPtr());  // Destroys |this|.
     return;
@@ -2509,7 +2547,7 @@ void SpdySession::PumpWriteLoop(WriteState expected_write_state, int result) {
 
 void SpdySession::MaybePostWriteLoop() {
   if (write_state_ == WRITE_STATE_IDLE) {
-    CHECK(!in_flight_write_);
+    CHECK(in_flight_writes_.empty());
     write_state_ = WRITE_STATE_DO_WRITE;
     base::ThreadTaskRunnerHandle::Get()->PostTask(
         FROM_HERE,
@@ -2560,57 +2598,35 @@ int SpdySession::DoWrite() {
   CHECK(in_io_loop_);
 
   DCHECK(buffered_spdy_framer_);
-  if (in_flight_write_) {
-    DCHECK_GT(in_flight_write_->GetRemainingSize(), 0u);
+  if (!in_flight_writes_.empty()) {
+    DCHECK_GT(in_flight_writes_.front().buffer->GetRemainingSize(), 0u);
   } else {
     // Grab the next frame to send.
-    spdy::SpdyFrameType frame_type = spdy::SpdyFrameType::DATA;
-    std::unique_ptr<SpdyBufferProducer> producer;
-    base::WeakPtr<SpdyStream> stream;
-    if (!write_queue_.Dequeue(&frame_type, &producer, &stream,
-                              &in_flight_write_traffic_annotation_)) {
+    int rv = DequeueWrite(&in_flight_write_traffic_annotation_);
+    if (rv == ERR_IO_PENDING) {
       write_state_ = WRITE_STATE_IDLE;
       return ERR_IO_PENDING;
     }
-
-    if (stream.get())
-      CHECK(!stream->IsClosed());
-
-    // Activate the stream only when sending the HEADERS frame to
-    // guarantee monotonically-increasing stream IDs.
-    if (frame_type == spdy::SpdyFrameType::HEADERS) {
-      CHECK(stream.get());
-      CHECK_EQ(stream->stream_id(), 0u);
-      std::unique_ptr<SpdyStream> owned_stream =
-          ActivateCreatedStream(stream.get());
-      InsertActivatedStream(std::move(owned_stream));
-
-      if (stream_hi_water_mark_ > kLastStreamId) {
-        CHECK_EQ(stream->stream_id(), kLastStreamId);
-        // We've exhausted the stream ID space, and no new streams may be
-        // created after this one.
-        MakeUnavailable();
-        StartGoingAway(kLastStreamId, ERR_HTTP2_PROTOCOL_ERROR);
-      }
-    }
-
-    in_flight_write_ = producer->ProduceBuffer();
-    if (!in_flight_write_) {
-      NOTREACHED();
-      return ERR_UNEXPECTED;
-    }
-    in_flight_write_frame_type_ = frame_type;
-    in_flight_write_frame_size_ = in_flight_write_->GetRemainingSize();
-    DCHECK_GE(in_flight_write_frame_size_, spdy::kFrameMinimumSize);
-    in_flight_write_stream_ = stream;
+    if (rv != OK)
+      return rv;
+    CoalesceWrites();
   }
 
   write_state_ = WRITE_STATE_DO_WRITE_COMPLETE;
 
-  scoped_refptr<IOBuffer> write_io_buffer =
-      in_flight_write_->GetIOBufferForRemainingData();
+  scoped_refptr<IOBuffer> write_io_buffer;
+  size_t write_size;
+  if (in_flight_write_buffer_) {
+    write_io_buffer = in_flight_write_buffer_;
+    write_size = in_flight_write_buffer_->BytesRemaining();
+  } else {
+    DCHECK_EQ(in_flight_writes_.size(), 1u);
+    SpdyBuffer* buffer = in_flight_writes_.front().buffer.get();
+    write_io_buffer = buffer->GetIOBufferForRemainingData();
+    write_size = buffer->GetRemainingSize();
+  }
   return socket_->Write(
-      write_io_buffer.get(), in_flight_write_->GetRemainingSize(),
+      write_io_buffer.get(), write_size,
       base::BindOnce(&SpdySession::PumpWriteLoop, weak_factory_.GetWeakPtr(),
                      WRITE_STATE_DO_WRITE_COMPLETE),
       NetworkTrafficAnnotationTag(in_flight_write_traffic_annotation_));
@@ -2619,14 +2635,12 @@ int SpdySession::DoWrite() {
 int SpdySession::DoWriteComplete(int result) {
   CHECK(in_io_loop_);
   DCHECK_NE(result, ERR_IO_PENDING);
-  DCHECK_GT(in_flight_write_->GetRemainingSize(), 0u);
+  DCHECK(!in_flight_writes_.empty());
 
   if (result < 0) {
     DCHECK_NE(result, ERR_IO_PENDING);
-    in_flight_write_.reset();
-    in_flight_write_frame_type_ = spdy::SpdyFrameType::DATA;
-    in_flight_write_frame_size_ = 0;
-    in_flight_write_stream_.reset();
+    in_flight_writes_.clear();
+    in_flight_write_buffer_.reset();
     in_flight_write_traffic_annotation_.reset();
     write_state_ = WRITE_STATE_DO_WRITE;
     DoDrainSession(static_cast<Error>(result), "Write error");
@@ -2634,36 +2648,123 @@ int SpdySession::DoWriteComplete(int result) {
   }
 
   // It should not be possible to have written more bytes than our
-  // in_flight_write_.
-  DCHECK_LE(static_cast<size_t>(result), in_flight_write_->GetRemainingSize());
-
-  if (result > 0) {
-    in_flight_write_->Consume(static_cast<size_t>(result));
-    if (in_flight_write_stream_.get())
-      in_flight_write_stream_->AddRawSentBytes(static_cast<size_t>(result));
+  // in-flight write.
+  DCHECK(!in_flight_write_buffer_ ||
+         result <= in_flight_write_buffer_->BytesRemaining());
+  DCHECK(in_flight_write_buffer_ ||
+         static_cast<size_t>(result) <=
+             in_flight_writes_.front().buffer->GetRemainingSize());
+
+  if (in_flight_write_buffer_ && result > 0)
+    in_flight_write_buffer_->DidConsume(result);
+
+  // Attribute the written bytes to the frames in the order they were
+  // written.
+  size_t bytes_left = static_cast<size_t>(result);
+  while (bytes_left > 0) {
+    DCHECK(!in_flight_writes_.empty());
+    InFlightWrite& write = in_flight_writes_.front();
+    size_t consume_size =
+        std::min(bytes_left, write.buffer->GetRemainingSize());
+    write.buffer->Consume(consume_size);
+    if (write.stream.get())
+      write.stream->AddRawSentBytes(consume_size);
+    bytes_left -= consume_size;
 
     // We only notify the stream when we've fully written the pending frame.
-    if (in_flight_write_->GetRemainingSize() == 0) {
-      // It is possible that the stream was cancelled while we were
-      // writing to the socket.
-      if (in_flight_write_stream_.get()) {
-        DCHECK_GT(in_flight_write_frame_size_, 0u);
-        in_flight_write_stream_->OnFrameWriteComplete(
-            in_flight_write_frame_type_, in_flight_write_frame_size_);
-      }
+    if (write.buffer->GetRemainingSize() > 0)
+      break;
 
-      // Cleanup the write which just completed.
-      in_flight_write_.reset();
-      in_flight_write_frame_type_ = spdy::SpdyFrameType::DATA;
-      in_flight_write_frame_size_ = 0;
-      in_flight_write_stream_.reset();
+    // It is possible that the stream was cancelled while we were
+    // writing to the socket.
+    if (write.stream.get()) {
+      DCHECK_GT(write.frame_size, 0u);
+      write.stream->OnFrameWriteComplete(write.frame_type, write.frame_size);
     }
+
+    // Cleanup the frame which just completed.
+    in_flight_writes_.pop_front();
   }
 
+  if (in_flight_writes_.empty())
+    in_flight_write_buffer_.reset();
+
   write_state_ = WRITE_STATE_DO_WRITE;
   return OK;
 }
 
+int SpdySession::DequeueWrite(
+    MutableNetworkTrafficAnnotationTag* traffic_annotation) {
+  spdy::SpdyFrameType frame_type = spdy::SpdyFrameType::DATA;
+  std::unique_ptr<SpdyBufferProducer> producer;
+  base::WeakPtr<SpdyStream> stream;
+  if (!write_queue_.Dequeue(&frame_type, &producer, &stream,
+                            traffic_annotation)) {
+    return ERR_IO_PENDING;
+  }
+
+  if (stream.get())
+    CHECK(!stream->IsClosed());
+
+  // Activate the stream only when sending the HEADERS frame to
+  // guarantee monotonically-increasing stream IDs.
+  if (frame_type == spdy::SpdyFrameType::HEADERS) {
+    CHECK(stream.get());
+    CHECK_EQ(stream->stream_id(), 0u);
+    std::unique_ptr<SpdyStream> owned_stream =
+        ActivateCreatedStream(stream.get());
+    InsertActivatedStream(std::move(owned_stream));
+
+    if (stream_hi_water_mark_ > kLastStreamId) {
+      CHECK_EQ(stream->stream_id(), kLastStreamId);
+      // We've exhausted the stream ID space, and no new streams may be
+      // created after this one.
+      MakeUnavailable();
+      StartGoingAway(kLastStreamId, ERR_HTTP2_PROTOCOL_ERROR);
+    }
+  }
+
+  InFlightWrite write;
+  write.buffer = producer->ProduceBuffer();
+  if (!write.buffer) {
+    NOTREACHED();
+    return ERR_UNEXPECTED;
+  }
+  write.frame_type = frame_type;
+  write.frame_size = write.buffer->GetRemainingSize();
+  DCHECK_GE(write.frame_size, spdy::kFrameMinimumSize);
+  write.stream = stream;
+  in_flight_writes_.push_back(std::move(write));
+  return OK;
+}
+
+void SpdySession::CoalesceWrites() {
+  DCHECK_EQ(in_flight_writes_.size(), 1u);
+  DCHECK(!in_flight_write_buffer_);
+
+  size_t total_size = in_flight_writes_.front().buffer->GetRemainingSize();
+  // The first frame's traffic annotation covers the whole write.
+  MutableNetworkTrafficAnnotationTag traffic_annotation;
+  while (total_size < write_coalescing_size_ &&
+         availability_state_ != STATE_DRAINING) {
+    if (DequeueWrite(&traffic_annotation) != OK)
+      break;
+    total_size += in_flight_writes_.back().buffer->GetRemainingSize();
+  }
+  if (in_flight_writes_.size() == 1)
+    return;
+
+  auto buffer = base::MakeRefCounted<IOBuffer>(total_size);
+  size_t offset = 0;
+  for (const InFlightWrite& write : in_flight_writes_) {
+    size_t size = write.buffer->GetRemainingSize();
+    memcpy(buffer->data() + offset, write.buffer->GetRemainingData(), size);
+    offset += size;
+  }
+  in_flight_write_buffer_ =
+      base::MakeRefCounted<DrainableIOBuffer>(std::move(buffer), total_size);
+}
+
 void SpdySession::NotifyRequestsOfConfirmation(int rv) {
   for (auto& callback : waiting_for_confirmation_callbacks_) {
     base::ThreadTaskRunnerHandle::Get()->PostTask(
@@ -3010,6 +3111,10 @@ void SpdySession::EnqueueWrite(
 
   write_queue_.Enqueue(priority, frame_type, std::move(producer), stream,
                        traffic_annotation);
+  size_t depth = write_queue_.num_queued_frames();
+  stats_.write_queue_depth_sum += depth;
+  stats_.num_write_queue_samples++;
+  stats_.max_write_queue_depth = std::max(stats_.max_write_queue_depth, depth);
   MaybePostWriteLoop();
 }
 
@@ -3041,12 +3146,13 @@ void SpdySession::InsertActivatedStream(std::unique_ptr<SpdyStream> stream) {
 }
 
 void SpdySession::DeleteStream(std::unique_ptr<SpdyStream> stream, int status) {
-  if (in_flight_write_stream_.get() == stream.get()) {
-    // If we're deleting the stream for the in-flight write, we still
-    // need to let the write complete, so we clear
-    // |in_flight_write_stream_| and let the write finish on its own
-    // without notifying |in_flight_write_stream_|.
-    in_flight_write_stream_.reset();
+  for (InFlightWrite& write : in_flight_writes_) {
+    if (write.stream.get() == stream.get()) {
+      // If we're deleting the stream for an in-flight write, we still
+      // need to let the write complete, so we clear |write.stream| and
+      // let the write finish on its own without notifying the stream.
+      write.stream.reset();
+    }
   }
 
   write_queue_.RemovePendingWritesForStream(stream.get());
@@ -3054,6 +3160,13 @@ void SpdySession::DeleteStream(std::unique_ptr<SpdyStream> stream, int status) {
     MaybeDisableBrokenConnectionDetection();
   stream->OnClose(status);
 
+  stats_.num_closed_streams++;
+  stats_.data_bytes_sent += stream->send_bytes();
+  stats_.data_bytes_received += stream->recv_bytes();
+  stats_.num_send_stalls += stream->num_send_stalls();
+  stats_.send_stalled_by_stream_time += stream->send_stalled_by_stream_time();
+  stats_.send_stalled_by_session_time += stream->send_stalled_by_session_time();
+
   if (availability_state_ == STATE_AVAILABLE) {
     ProcessPendingStreamRequests();
   }
@@ -3270,8 +3383,16 @@ void SpdySession::OnPing(spdy::SpdyPingId unique_id, bool is_ack) {
 
   ping_in_flight_ = false;
 
+  if (bdp_ping_in_flight_) {
+    bdp_ping_in_flight_ = false;
+    OnBdpSample();
+  }
+
   // Record RTT in histogram when there are no more pings in flight.
   base::TimeDelta ping_duration = time_func_() - last_ping_sent_time_;
+  stats_.ping_rtt_sum += ping_duration;
+  stats_.num_ping_rtts++;
+  stats_.max_ping_rtt = std::max(stats_.max_ping_rtt, ping_duration);
   if (network_quality_estimator_) {
     network_quality_estimator_->RecordSpdyPingLatency(host_port_pair(),
                                                       ping_duration);
@@ -3389,12 +3510,27 @@ void SpdySession::OnStreamFrameData(spdy::SpdyStreamId stream_id,
   std::unique_ptr<SpdyBuffer> buffer;
   if (data) {
     DCHECK_GT(len, 0u);
-    CHECK_LE(len, static_cast<size_t>(kReadBufferSize));
-    buffer = std::make_unique<SpdyBuffer>(data, len);
+    CHECK_LE(len, static_cast<size_t>(kMaxReadBufferSize));
+    if (read_buffer_ &&
+        len * kMaxReadBufferPinRatio >=
+            static_cast<size_t>(read_buffer_->size()) &&
+        data >= read_buffer_->data() &&
+        data + len <= read_buffer_->data() + read_buffer_->size()) {
+      buffer = std::make_unique<SpdyBuffer>(
+          read_buffer_, static_cast<size_t>(data - read_buffer_->data()), len);
+    } else {
+      buffer = std::make_unique<SpdyBuffer>(data, len);
+    }
 
     DecreaseRecvWindowSize(static_cast<int32_t>(len));
     buffer->AddConsumeCallback(base::BindRepeating(
         &SpdySession::OnReadBufferConsumed, weak_factory_.GetWeakPtr()));
+
+    if (bdp_ping_in_flight_) {
+      bdp_sample_bytes_ += len;
+    } else {
+      MaybeStartBdpSample();
+    }
   } else {
     DCHECK_EQ(len, 0u);
   }
@@ -3409,6 +3545,8 @@ void SpdySession::OnStreamFrameData(spdy::SpdyStreamId stream_id,
   CHECK_EQ(stream->stream_id(), stream_id);
 
   stream->AddRawReceivedBytes(len);
+  if (bdp_ping_in_flight_)
+    stream->AddBdpSampleBytes(len);
   stream->OnDataReceived(std::move(buffer));
 }
 
@@ -3713,6 +3851,12 @@ void SpdySession::IncreaseSendWindowSize(int delta_window_size) {
                                                session_send_window_size_);
   });
 
+  if (!session_send_window_exhausted_time_.is_null()) {
+    stats_.session_send_window_exhausted_time +=
+        time_func_() - session_send_window_exhausted_time_;
+    session_send_window_exhausted_time_ = base::TimeTicks();
+  }
+
   DCHECK(!IsSendStalled());
   ResumeSendStalledStreams();
 }
@@ -3733,6 +3877,9 @@ void SpdySession::DecreaseSendWindowSize(int32_t delta_window_size) {
     return NetLogSpdySessionWindowUpdateParams(-delta_window_size,
                                                session_send_window_size_);
   });
+
+  if (IsSendStalled())
+    session_send_window_exhausted_time_ = time_func_();
 }
 
 void SpdySession::OnReadBufferConsumed(
@@ -3804,6 +3951,70 @@ void SpdySession::DecreaseRecvWindowSize(int32_t delta_window_size) {
   });
 }
 
+void SpdySession::IncreaseMaxRecvWindowSize(int32_t max_recv_window_size) {
+  DCHECK_GT(max_recv_window_size, session_max_recv_window_size_);
+  int32_t delta_window_size =
+      max_recv_window_size - session_max_recv_window_size_;
+  session_max_recv_window_size_ = max_recv_window_size;
+  session_recv_window_size_ += delta_window_size;
+  net_log_.AddEvent(NetLogEventType::HTTP2_SESSION_UPDATE_RECV_WINDOW, [&] {
+    return NetLogSpdySessionWindowUpdateParams(delta_window_size,
+                                               session_recv_window_size_);
+  });
+
+  // Send the new space right away along with anything not yet acked.
+  session_unacked_recv_window_bytes_ += delta_window_size;
+  last_recv_window_update_ = base::TimeTicks::Now();
+  SendWindowUpdateFrame(spdy::kSessionFlowControlStreamId,
+                        session_unacked_recv_window_bytes_, HIGHEST);
+  session_unacked_recv_window_bytes_ = 0;
+}
+
+void SpdySession::MaybeStartBdpSample() {
+  if (recv_window_auto_tuning_limit_ == 0 || ping_in_flight_ ||
+      availability_state_ == STATE_DRAINING ||
+      time_func_() < next_bdp_sample_time_) {
+    return;
+  }
+
+  bdp_ping_in_flight_ = true;
+  bdp_sample_bytes_ = 0;
+  WritePingFrame(next_ping_id_, false);
+}
+
+void SpdySession::OnBdpSample() {
+  auto grown_size = [this](int32_t window_size, int64_t sample_bytes) {
+    if (sample_bytes * 3 < int64_t{window_size} * 2)
+      return window_size;
+    return static_cast<int32_t>(std::max<int64_t>(
+        window_size,
+        std::min<int64_t>(sample_bytes * 2, recv_window_auto_tuning_limit_)));
+  };
+
+  bool grown = false;
+  int32_t window_size =
+      grown_size(session_max_recv_window_size_, bdp_sample_bytes_);
+  bdp_sample_bytes_ = 0;
+  if (window_size > session_max_recv_window_size_) {
+    IncreaseMaxRecvWindowSize(window_size);
+    grown = true;
+  }
+  for (const auto& active_stream : active_streams_) {
+    SpdyStream* stream = active_stream.second;
+    window_size = grown_size(stream->max_recv_window_size(),
+                             stream->TakeBdpSampleBytes());
+    if (window_size > stream->max_recv_window_size()) {
+      stream->IncreaseMaxRecvWindowSize(window_size);
+      grown = true;
+    }
+  }
+
+  // Keep sampling while windows grow; otherwise check once in a while.
+  next_bdp_sample_time_ = time_func_();
+  if (!grown)
+    next_bdp_sample_time_ += base::Seconds(kBdpSampleIntervalSeconds);
+}
+
 void SpdySession::QueueSendStalledStream(const SpdyStream& stream) {
   DCHECK(stream.send_stalled_by_flow_control() || IsSendStalled());
   RequestPriority priority = stream.priority();
@@ -44,6 +44,7 @@
 #include "net/spdy/server_push_delegate.h"
 #include "net/spdy/spdy_buffer.h"
 #include "net/spdy/spdy_session_pool.h"
+#include "net/spdy/spdy_session_stats.h"
 #include "net/spdy/spdy_stream.h"
 #include "net/spdy/spdy_write_queue.h"
 #include "net/ssl/ssl_config_service.h"
@@ -361,6 +362,8 @@ class NET_EXPORT SpdySession
               bool is_quic_enabled,
               size_t session_max_recv_window_size,
               int session_max_queued_capped_frames,
+              size_t write_coalescing_size,
+              size_t recv_window_auto_tuning_limit,
               const spdy::SettingsMap& initial_settings,
               bool enable_http2_settings_grease,
               const absl::optional<SpdySessionPool::GreasedHttp2Frame>&
@@ -627,6 +630,15 @@ class NET_EXPORT SpdySession
   // session flow control.
   bool IsSendStalled() const { return session_send_window_size_ == 0; }
 
+  // Returns the number of streams that are open or being opened.
+  size_t num_open_streams() const {
+    return active_streams_.size() + created_streams_.size();
+  }
+
+  // Counters of this session. Streams are counted once they close, and the
+  // ongoing session send window exhaustion once it ends.
+  const SpdySessionStats& stats() const { return stats_; }
+
   const NetLogWithSource& net_log() const { return net_log_; }
 
   int GetPeerAddress(IPEndPoint* address) const;
@@ -713,6 +725,23 @@ class NET_EXPORT SpdySession
     WRITE_STATE_DO_WRITE_COMPLETE,
   };
 
+  // A frame taken off |write_queue_| that has not been written to the socket
+  // completely.
+  struct InFlightWrite {
+    InFlightWrite();
+    InFlightWrite(InFlightWrite&&);
+    InFlightWrite& operator=(InFlightWrite&&);
+    ~InFlightWrite();
+
+    // The unwritten part of the frame.
+    std::unique_ptr<SpdyBuffer> buffer;
+    spdy::SpdyFrameType frame_type = spdy::SpdyFrameType::DATA;
+    size_t frame_size = 0;
+    // The stream to notify when |buffer| has been written to the socket
+    // completely.
+    base::WeakPtr<SpdyStream> stream;
+  };
+
   // Has the shared logic for the other two Initialize methods that call it.
   void InitializeInternal(SpdySessionPool* pool);
 
@@ -815,6 +844,17 @@ class NET_EXPORT SpdySession
   int DoWrite();
   int DoWriteComplete(int result);
 
+  // Takes the next frame off |write_queue_| and appends it to
+  // |in_flight_writes_|, activating its stream if it is a HEADERS frame.
+  // Returns ERR_IO_PENDING if the write queue is empty.
+  int DequeueWrite(MutableNetworkTrafficAnnotationTag* traffic_annotation);
+
+  // Keeps taking frames off |write_queue_| in priority order until
+  // |write_coalescing_size_| bytes are in flight, and if more than one frame
+  // was taken, copies them into |in_flight_write_buffer_| so that they go out
+  // in a single socket write.
+  void CoalesceWrites();
+
   void NotifyRequestsOfConfirmation(int rv);
 
   // TODO(akalin): Rename the Send* and Write* functions below to
@@ -1043,6 +1083,23 @@ class NET_EXPORT SpdySession
   // If session flow control is turned off, this must not be called.
   void DecreaseRecvWindowSize(int32_t delta_window_size);
 
+  // Grows the maximum receive window size of the session to
+  // |max_recv_window_size|, which must be larger than the current one, and
+  // immediately sends a WINDOW_UPDATE frame for the difference.
+  void IncreaseMaxRecvWindowSize(int32_t max_recv_window_size);
+
+  // Receive window auto-tuning. A sample of the bandwidth-delay product is
+  // the number of DATA bytes received between sending a PING and receiving
+  // its ACK. Starts a sample if auto-tuning is enabled, no PING is in flight
+  // and the last sample is not too recent.
+  void MaybeStartBdpSample();
+
+  // Ends the current sample. Windows of the session and its active streams
+  // that received at least two thirds of their size within the round trip
+  // grow to twice the sample, up to |recv_window_auto_tuning_limit_|, so that
+  // the peer is not held back by WINDOW_UPDATE round trips.
+  void OnBdpSample();
+
   // Queue a send-stalled stream for possibly resuming once we're not
   // send-stalled anymore.
   void QueueSendStalledStream(const SpdyStream& stream);
@@ -1105,9 +1162,17 @@ class NET_EXPORT SpdySession
   // The socket for this session.
   raw_ptr<StreamSocket> socket_;
 
-  // The read buffer used to read data from the socket.
-  // Non-null if there is a Read() pending.
-  scoped_refptr<IOBuffer> read_buffer_;
+  // The buffer for socket reads, |read_buffer_size_| bytes long. It is kept
+  // and reused by consecutive reads, and only replaced when the read size
+  // changes or DATA payloads delivered as slices of it are still held. It is
+  // released while ReadIfReady() waits for data, but held by a pending Read()
+  // when the socket does not support ReadIfReady().
+  scoped_refptr<IOBufferWithSize> read_buffer_;
+
+  // The size of the next read, between 8 KiB and 256 KiB. Doubles when a read
+  // fills |read_buffer_| and halves when a read uses less than a quarter of
+  // it.
+  int read_buffer_size_;
 
   spdy::SpdyStreamId stream_hi_water_mark_;  // The next stream id to use.
 
@@ -1159,17 +1224,17 @@ class NET_EXPORT SpdySession
   // The write queue.
   SpdyWriteQueue write_queue_;
 
-  // Data for the frame we are currently sending.
+  // Data for the frames we are currently sending, in the order they are
+  // written.
+  base::circular_deque<InFlightWrite> in_flight_writes_;
+
+  // A contiguous copy of the remaining data of |in_flight_writes_| if it
+  // holds more than one frame, null otherwise.
+  scoped_refptr<DrainableIOBuffer> in_flight_write_buffer_;
 
-  // The buffer we're currently writing.
-  std::unique_ptr<SpdyBuffer> in_flight_write_;
-  // The type of the frame in |in_flight_write_|.
-  spdy::SpdyFrameType in_flight_write_frame_type_;
-  // The size of the frame in |in_flight_write_|.
-  size_t in_flight_write_frame_size_;
-  // The stream to notify when |in_flight_write_| has been written to
-  // the socket completely.
-  base::WeakPtr<SpdyStream> in_flight_write_stream_;
+  // Maximum number of bytes to coalesce into a single socket write. Zero
+  // writes one frame at a time.
+  const size_t write_coalescing_size_;
 
   // Traffic annotation for the write in progress.
   MutableNetworkTrafficAnnotationTag in_flight_write_traffic_annotation_;
@@ -1306,6 +1371,25 @@ class NET_EXPORT SpdySession
   // Time to accumilate small receive window updates for.
   base::TimeDelta time_to_buffer_small_window_updates_;
 
+  // Size up to which receive windows grow by auto-tuning. Zero disables
+  // auto-tuning.
+  const int32_t recv_window_auto_tuning_limit_;
+
+  // True if the PING in flight was sent for a bandwidth-delay product sample.
+  bool bdp_ping_in_flight_;
+
+  // DATA bytes received for the session since the sample's PING was sent.
+  int64_t bdp_sample_bytes_;
+
+  // No sample is started before this time.
+  base::TimeTicks next_bdp_sample_time_;
+
+  // When |session_send_window_size_| last dropped to zero, or null if it is
+  // positive.
+  base::TimeTicks session_send_window_exhausted_time_;
+
+  SpdySessionStats stats_;
+
   // Initial send window size for this session's streams. Can be
   // changed by an arriving SETTINGS frame. Newly created streams use
   // this value for the initial send window size.
@@ -85,6 +85,8 @@ SpdySessionPool::SpdySessionPool(
     bool is_quic_enabled,
     size_t session_max_recv_window_size,
     int session_max_queued_capped_frames,
+    size_t session_write_coalescing_size,
+    size_t session_recv_window_auto_tuning_limit,
     const spdy::SettingsMap& initial_settings,
     bool enable_http2_settings_grease,
     const absl::optional<GreasedHttp2Frame>& greased_http2_frame,
@@ -106,6 +108,9 @@ SpdySessionPool::SpdySessionPool(
       is_quic_enabled_(is_quic_enabled),
       session_max_recv_window_size_(session_max_recv_window_size),
       session_max_queued_capped_frames_(session_max_queued_capped_frames),
+      session_write_coalescing_size_(session_write_coalescing_size),
+      session_recv_window_auto_tuning_limit_(
+          session_recv_window_auto_tuning_limit),
       initial_settings_(initial_settings),
       enable_http2_settings_grease_(enable_http2_settings_grease),
       greased_http2_frame_(greased_http2_frame),
@@ -234,6 +239,21 @@ base::WeakPtr<SpdySession> SpdySessionPool::FindAvailableSession(
   return base::WeakPtr<SpdySession>();
 }
 
+bool SpdySessionPool::HasAvailableSession(const SpdySessionKey& key,
+                                          bool is_websocket) const {
+  const auto it = available_sessions_.find(key);
+  return it != available_sessions_.end() &&
+         (!is_websocket || it->second->support_websocket());
+}
+
+base::WeakPtr<SpdySession> SpdySessionPool::GetAvailableSession(
+    const SpdySessionKey& key) const {
+  const auto it = available_sessions_.find(key);
+  if (it == available_sessions_.end())
+    return base::WeakPtr<SpdySession>();
+  return it->second;
+}
+
 base::WeakPtr<SpdySession> SpdySessionPool::RequestSession(
     const SpdySessionKey& key,
     bool enable_ip_based_pooling,
@@ -445,6 +465,14 @@ void SpdySessionPool::RemoveUnavailableSession(
   CHECK(it != sessions_.end());
   std::unique_ptr<SpdySession> owned_session(*it);
   sessions_.erase(it);
+  removed_session_stats_.Add(owned_session->stats());
+}
+
+SpdySessionStats SpdySessionPool::GetSessionStats() const {
+  SpdySessionStats stats = removed_session_stats_;
+  for (const SpdySession* session : sessions_)
+    stats.Add(session->stats());
+  return stats;
 }
 
 // Make a copy of |sessions_| in the Close* functions below to avoid
@@ -671,7 +699,8 @@ std::unique_ptr<SpdySession> SpdySessionPool::CreateSession(
       quic_supported_versions_, enable_sending_initial_data_,
       enable_ping_based_connection_checking_, is_http2_enabled_,
       is_quic_enabled_, session_max_recv_window_size_,
-      session_max_queued_capped_frames_, initial_settings_,
+      session_max_queued_capped_frames_, session_write_coalescing_size_,
+      session_recv_window_auto_tuning_limit_, initial_settings_,
       enable_http2_settings_grease_, greased_http2_frame_,
       http2_end_stream_with_data_frame_, enable_priority_update_, time_func_,
       push_delegate_, network_quality_estimator_, net_log);
@@ -31,6 +31,7 @@
 #include "net/spdy/http2_push_promise_index.h"
 #include "net/spdy/server_push_delegate.h"
 #include "net/spdy/spdy_session_key.h"
+#include "net/spdy/spdy_session_stats.h"
 #include "net/ssl/ssl_config_service.h"
 #include "net/third_party/quiche/src/quic/core/quic_versions.h"
 #include "net/third_party/quiche/src/spdy/core/spdy_protocol.h"
@@ -138,6 +139,8 @@ class NET_EXPORT SpdySessionPool
                   bool is_quic_enabled,
                   size_t session_max_recv_window_size,
                   int session_max_queued_capped_frames,
+                  size_t session_write_coalescing_size,
+                  size_t session_recv_window_auto_tuning_limit,
                   const spdy::SettingsMap& initial_settings,
                   bool enable_http2_settings_grease,
                   const absl::optional<GreasedHttp2Frame>& greased_http2_frame,
@@ -204,6 +207,15 @@ class NET_EXPORT SpdySessionPool
       bool is_websocket,
       const NetLogWithSource& net_log);
 
+  // Returns true if there is an available session for exactly |key|. Unlike
+  // FindAvailableSession(), does not pool by IP address or log.
+  bool HasAvailableSession(const SpdySessionKey& key, bool is_websocket) const;
+
+  // Returns the available session for exactly |key|, or nullptr. Like
+  // HasAvailableSession(), has no side effects.
+  base::WeakPtr<SpdySession> GetAvailableSession(
+      const SpdySessionKey& key) const;
+
   // Just like FindAvailableSession.
   //
   // Additionally, if it returns nullptr, populates |spdy_session_request| with
@@ -280,6 +292,12 @@ class NET_EXPORT SpdySessionPool
   // Creates a Value summary of the state of the spdy session pool.
   std::unique_ptr<base::Value> SpdySessionPoolInfoToValue() const;
 
+  // Returns the number of sessions, including unavailable ones.
+  size_t num_sessions() const { return sessions_.size(); }
+
+  // Returns the counters of all sessions, including removed ones, summed.
+  SpdySessionStats GetSessionStats() const;
+
   HttpServerProperties* http_server_properties() {
     return http_server_properties_;
   }
@@ -419,6 +437,9 @@ class NET_EXPORT SpdySessionPool
   // |sessions_| owns all its SpdySession objects.
   SessionSet sessions_;
 
+  // Counters of sessions removed from |sessions_|.
+  SpdySessionStats removed_session_stats_;
+
   // This is a map of available sessions by key. A session may appear
   // more than once in this map if it has aliases.
   AvailableSessionMap available_sessions_;
@@ -450,6 +471,12 @@ class NET_EXPORT SpdySessionPool
   // Maximum number of capped frames that can be queued at any time.
   int session_max_queued_capped_frames_;
 
+  // Maximum number of bytes of ready frames to write to the socket at once.
+  size_t session_write_coalescing_size_;
+
+  // Size up to which receive windows of sessions and streams may grow.
+  size_t session_recv_window_auto_tuning_limit_;
+
   // Settings that are sent in the initial SETTINGS frame
   // (if |enable_sending_initial_data_| is true),
   // and also control SpdySession parameters like initial receive window size
@@ -0,0 +1,39 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/spdy_session_stats.h"
+
+#include <algorithm>
+
+namespace net {
+
+SpdySessionStats::SpdySessionStats() = default;
+
+SpdySessionStats::SpdySessionStats(const SpdySessionStats&) = default;
+
+SpdySessionStats& SpdySessionStats::operator=(const SpdySessionStats&) =
+    default;
+
+SpdySessionStats::~SpdySessionStats() = default;
+
+void SpdySessionStats::Add(const SpdySessionStats& other) {
+  num_closed_streams += other.num_closed_streams;
+  data_bytes_sent += other.data_bytes_sent;
+  data_bytes_received += other.data_bytes_received;
+  num_send_stalls += other.num_send_stalls;
+  send_stalled_by_stream_time += other.send_stalled_by_stream_time;
+  send_stalled_by_session_time += other.send_stalled_by_session_time;
+  session_send_window_exhausted_time +=
+      other.session_send_window_exhausted_time;
+  write_queue_depth_sum += other.write_queue_depth_sum;
+  num_write_queue_samples += other.num_write_queue_samples;
+  max_write_queue_depth =
+      std::max(max_write_queue_depth, other.max_write_queue_depth);
+  num_read_yields += other.num_read_yields;
+  ping_rtt_sum += other.ping_rtt_sum;
+  num_ping_rtts += other.num_ping_rtts;
+  max_ping_rtt = std::max(max_ping_rtt, other.max_ping_rtt);
+}
+
+}  // namespace net
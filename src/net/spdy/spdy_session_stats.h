@@ -0,0 +1,58 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_SPDY_SPDY_SESSION_STATS_H_
+#define NET_SPDY_SPDY_SESSION_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/time/time.h"
+#include "net/base/net_export.h"
+
+namespace net {
+
+// Counters of an HTTP/2 session, or summed over the sessions of a
+// SpdySessionPool, for telling flow control stalls, write queueing and peer
+// latency apart without capturing a full NetLog.
+struct NET_EXPORT_PRIVATE SpdySessionStats {
+  SpdySessionStats();
+  SpdySessionStats(const SpdySessionStats&);
+  SpdySessionStats& operator=(const SpdySessionStats&);
+  ~SpdySessionStats();
+
+  // Adds |other| to these counters, keeping the larger maximum.
+  void Add(const SpdySessionStats& other);
+
+  // Streams closed so far and the DATA payload bytes they carried.
+  int64_t num_closed_streams = 0;
+  int64_t data_bytes_sent = 0;
+  int64_t data_bytes_received = 0;
+
+  // Times streams stalled on sending DATA, and how long they waited on their
+  // own send window or on the session's.
+  int64_t num_send_stalls = 0;
+  base::TimeDelta send_stalled_by_stream_time;
+  base::TimeDelta send_stalled_by_session_time;
+
+  // How long the session send window was exhausted.
+  base::TimeDelta session_send_window_exhausted_time;
+
+  // Frames in the write queue, sampled whenever a frame is queued.
+  int64_t write_queue_depth_sum = 0;
+  int64_t num_write_queue_samples = 0;
+  size_t max_write_queue_depth = 0;
+
+  // Times the read loop reposted itself to yield to other tasks.
+  int64_t num_read_yields = 0;
+
+  // Round trip times of acknowledged PINGs.
+  base::TimeDelta ping_rtt_sum;
+  int64_t num_ping_rtts = 0;
+  base::TimeDelta max_ping_rtt;
+};
+
+}  // namespace net
+
+#endif  // NET_SPDY_SPDY_SESSION_STATS_H_
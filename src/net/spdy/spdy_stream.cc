@@ -27,6 +27,7 @@
 #include "net/log/net_log.h"
 #include "net/log/net_log_capture_mode.h"
 #include "net/log/net_log_event_type.h"
+#include "net/log/net_log_values.h"
 #include "net/spdy/spdy_buffer_producer.h"
 #include "net/spdy/spdy_http_utils.h"
 #include "net/spdy/spdy_session.h"
@@ -65,6 +66,24 @@ base::Value NetLogSpdyDataParams(spdy::SpdyStreamId stream_id,
   return dict;
 }
 
+base::Value NetLogSpdyStreamStatsParams(spdy::SpdyStreamId stream_id,
+                                        const SpdyStream& stream,
+                                        base::TimeDelta lifetime) {
+  base::Value dict(base::Value::Type::DICTIONARY);
+  dict.SetIntKey("stream_id", static_cast<int>(stream_id));
+  dict.SetKey("lifetime_ms", NetLogNumberValue(lifetime.InMilliseconds()));
+  dict.SetKey("send_bytes", NetLogNumberValue(stream.send_bytes()));
+  dict.SetKey("recv_bytes", NetLogNumberValue(stream.recv_bytes()));
+  dict.SetIntKey("send_stalls", stream.num_send_stalls());
+  dict.SetKey(
+      "send_stalled_by_stream_ms",
+      NetLogNumberValue(stream.send_stalled_by_stream_time().InMilliseconds()));
+  dict.SetKey("send_stalled_by_session_ms",
+              NetLogNumberValue(
+                  stream.send_stalled_by_session_time().InMilliseconds()));
+  return dict;
+}
+
 }  // namespace
 
 // A wrapper around a stream that calls into ProduceHeadersFrame().
@@ -104,11 +123,14 @@ SpdyStream::SpdyStream(SpdyStreamType type,
       url_(url),
       priority_(priority),
       send_stalled_by_flow_control_(false),
+      send_stalled_by_session_(false),
+      num_send_stalls_(0),
       send_window_size_(initial_send_window_size),
       max_recv_window_size_(max_recv_window_size),
       recv_window_size_(max_recv_window_size),
       unacked_recv_window_bytes_(0),
       last_recv_window_update_(base::TimeTicks::Now()),
+      bdp_sample_bytes_(0),
       session_(session),
       delegate_(nullptr),
       request_headers_valid_(false),
@@ -120,6 +142,7 @@ SpdyStream::SpdyStream(SpdyStreamType type,
       raw_received_bytes_(0),
       raw_sent_bytes_(0),
       recv_bytes_(0),
+      send_bytes_(0),
       write_handler_guard_(false),
       traffic_annotation_(traffic_annotation),
       detect_broken_connection_(detect_broken_connection) {
@@ -374,6 +397,27 @@ void SpdyStream::DecreaseRecvWindowSize(int32_t delta_window_size) {
   });
 }
 
+void SpdyStream::IncreaseMaxRecvWindowSize(int32_t max_recv_window_size) {
+  if (!session_->IsStreamActive(stream_id_))
+    return;
+
+  DCHECK_GT(max_recv_window_size, max_recv_window_size_);
+  int32_t delta_window_size = max_recv_window_size - max_recv_window_size_;
+  max_recv_window_size_ = max_recv_window_size;
+  recv_window_size_ += delta_window_size;
+  net_log_.AddEvent(NetLogEventType::HTTP2_STREAM_UPDATE_RECV_WINDOW, [&] {
+    return NetLogSpdyStreamWindowUpdateParams(stream_id_, delta_window_size,
+                                              recv_window_size_);
+  });
+
+  // Send the new space right away along with anything not yet acked.
+  unacked_recv_window_bytes_ += delta_window_size;
+  last_recv_window_update_ = base::TimeTicks::Now();
+  session_->SendStreamWindowUpdate(
+      stream_id_, static_cast<uint32_t>(unacked_recv_window_bytes_));
+  unacked_recv_window_bytes_ = 0;
+}
+
 int SpdyStream::GetPeerAddress(IPEndPoint* address) const {
   return session_->GetPeerAddress(address);
 }
@@ -673,6 +717,8 @@ int SpdyStream::OnDataSent(size_t frame_size) {
   CHECK_GE(frame_size, spdy::kDataFrameMinimumSize);
   CHECK_LE(frame_payload_size, spdy::kHttp2DefaultFramePayloadLimit);
 
+  send_bytes_ += frame_payload_size;
+
   // If more data is available to send, dispatch it and
   // return that the write operation is still ongoing.
   pending_send_data_->DidConsume(frame_payload_size);
@@ -695,6 +741,13 @@ void SpdyStream::OnClose(int status) {
   // In most cases, the stream should already be CLOSED. The exception is when a
   // SpdySession is shutting down while the stream is in an intermediate state.
   io_state_ = STATE_CLOSED;
+  EndSendStall();
+  net_log_.AddEvent(NetLogEventType::HTTP2_STREAM_STATS, [&] {
+    base::TimeDelta lifetime;
+    if (!send_time_.is_null())
+      lifetime = base::TimeTicks::Now() - send_time_;
+    return NetLogSpdyStreamStatsParams(stream_id_, *this, lifetime);
+  });
   if (status == ERR_HTTP2_RST_STREAM_NO_ERROR_RECEIVED) {
     if (response_state_ == READY_FOR_HEADERS) {
       status = ERR_HTTP2_PROTOCOL_ERROR;
@@ -781,6 +834,27 @@ NextProto SpdyStream::GetNegotiatedProtocol() const {
   return session_->GetNegotiatedProtocol();
 }
 
+void SpdyStream::OnSendStalled(bool by_session) {
+  send_stalled_by_flow_control_ = true;
+  if (!send_stall_start_time_.is_null())
+    return;
+  send_stall_start_time_ = base::TimeTicks::Now();
+  send_stalled_by_session_ = by_session;
+  ++num_send_stalls_;
+}
+
+void SpdyStream::EndSendStall() {
+  if (send_stall_start_time_.is_null())
+    return;
+  base::TimeDelta stall_time = base::TimeTicks::Now() - send_stall_start_time_;
+  if (send_stalled_by_session_) {
+    send_stalled_by_session_time_ += stall_time;
+  } else {
+    send_stalled_by_stream_time_ += stall_time;
+  }
+  send_stall_start_time_ = base::TimeTicks();
+}
+
 SpdyStream::ShouldRequeueStream SpdyStream::PossiblyResumeIfSendStalled() {
   if (IsLocallyClosed() || !send_stalled_by_flow_control_)
     return DoNotRequeue;
@@ -791,6 +865,7 @@ SpdyStream::ShouldRequeueStream SpdyStream::PossiblyResumeIfSendStalled() {
       NetLogEventType::HTTP2_STREAM_FLOW_CONTROL_UNSTALLED, "stream_id",
       stream_id_);
   send_stalled_by_flow_control_ = false;
+  EndSendStall();
   QueueNextDataFrame();
   return DoNotRequeue;
 }
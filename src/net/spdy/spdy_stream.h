@@ -10,6 +10,7 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/memory/raw_ptr.h"
@@ -175,13 +176,16 @@ class NET_EXPORT_PRIVATE SpdyStream {
 
   int32_t recv_window_size() const { return recv_window_size_; }
 
+  int32_t max_recv_window_size() const { return max_recv_window_size_; }
+
   bool send_stalled_by_flow_control() const {
     return send_stalled_by_flow_control_;
   }
 
-  void set_send_stalled_by_flow_control(bool stalled) {
-    send_stalled_by_flow_control_ = stalled;
-  }
+  // Called by the session when sending DATA stalls on this stream's send
+  // window, or on the session's if |by_session|. The stall is timed until
+  // the stream resumes or closes.
+  void OnSendStalled(bool by_session);
 
   // Called by the session to adjust this stream's send window size by
   // |delta_window_size|, which is the difference between the
@@ -252,6 +256,17 @@ class NET_EXPORT_PRIVATE SpdyStream {
   // this must not be called.
   void DecreaseRecvWindowSize(int32_t delta_window_size);
 
+  // Called by the session to grow the maximum receive window size to
+  // |max_recv_window_size|, which must be larger than the current one, and
+  // immediately send a WINDOW_UPDATE frame for the difference. Does nothing
+  // if the stream is not active.
+  void IncreaseMaxRecvWindowSize(int32_t max_recv_window_size);
+
+  // DATA bytes received during the session's current bandwidth-delay product
+  // sample. See SpdySession::OnBdpSample().
+  void AddBdpSampleBytes(int64_t bytes) { bdp_sample_bytes_ += bytes; }
+  int64_t TakeBdpSampleBytes() { return std::exchange(bdp_sample_bytes_, 0); }
+
   int GetPeerAddress(IPEndPoint* address) const;
   int GetLocalAddress(IPEndPoint* address) const;
 
@@ -392,7 +407,18 @@ class NET_EXPORT_PRIVATE SpdyStream {
 
   int64_t raw_received_bytes() const { return raw_received_bytes_; }
   int64_t raw_sent_bytes() const { return raw_sent_bytes_; }
-  int recv_bytes() const { return recv_bytes_; }
+  int64_t recv_bytes() const { return recv_bytes_; }
+  int64_t send_bytes() const { return send_bytes_; }
+
+  // Flow control stalls of this stream, see OnSendStalled(). Ongoing stalls
+  // are counted once they end.
+  int num_send_stalls() const { return num_send_stalls_; }
+  base::TimeDelta send_stalled_by_stream_time() const {
+    return send_stalled_by_stream_time_;
+  }
+  base::TimeDelta send_stalled_by_session_time() const {
+    return send_stalled_by_session_time_;
+  }
   bool ShouldRetryRSTPushStream() const;
 
   bool GetLoadTimingInfo(LoadTimingInfo* load_timing_info) const;
@@ -452,6 +478,10 @@ class NET_EXPORT_PRIVATE SpdyStream {
   // to have occurred, driving the state machine forward.
   void PushedStreamReplay();
 
+  // Adds the time since the current send stall started, if any, to the
+  // stall totals.
+  void EndSendStall();
+
   // Produces the HEADERS frame for the stream. The stream must
   // already be activated.
   std::unique_ptr<spdy::SpdySerializedFrame> ProduceHeadersFrame();
@@ -479,6 +509,15 @@ class NET_EXPORT_PRIVATE SpdyStream {
 
   bool send_stalled_by_flow_control_;
 
+  // Start of the current send stall, or null, and whether the session's send
+  // window caused it.
+  base::TimeTicks send_stall_start_time_;
+  bool send_stalled_by_session_;
+
+  int num_send_stalls_;
+  base::TimeDelta send_stalled_by_stream_time_;
+  base::TimeDelta send_stalled_by_session_time_;
+
   // Current send window size.
   int32_t send_window_size_;
 
@@ -500,6 +539,10 @@ class NET_EXPORT_PRIVATE SpdyStream {
   // Time of the last WINDOW_UPDATE for the receive window
   base::TimeTicks last_recv_window_update_;
 
+  // DATA bytes received during the session's current bandwidth-delay product
+  // sample.
+  int64_t bdp_sample_bytes_;
+
   const base::WeakPtr<SpdySession> session_;
 
   // The transaction should own the delegate.
@@ -559,7 +602,9 @@ class NET_EXPORT_PRIVATE SpdyStream {
 
   // Number of data bytes that have been received on this stream, not including
   // frame overhead. Note that this does not count headers.
-  int recv_bytes_;
+  int64_t recv_bytes_;
+  // Number of data bytes that have been sent on this stream, likewise.
+  int64_t send_bytes_;
 
   // Guards calls of delegate write handlers ensuring |this| is not destroyed.
   // TODO(jgraettinger): Consider removing after crbug.com/35511 is tracked
@@ -10,7 +10,6 @@
 
 #include "base/check_op.h"
 #include "base/containers/circular_deque.h"
-#include "base/trace_event/memory_usage_estimator.h"
 #include "net/spdy/spdy_buffer.h"
 #include "net/spdy/spdy_buffer_producer.h"
 #include "net/spdy/spdy_stream.h"
@@ -44,6 +43,12 @@ SpdyWriteQueue::PendingWrite::PendingWrite(PendingWrite&& other) = default;
 SpdyWriteQueue::PendingWrite& SpdyWriteQueue::PendingWrite::operator=(
     PendingWrite&& other) = default;
 
+SpdyWriteQueue::StreamWrites::StreamWrites(SpdyStream* stream,
+                                           RequestPriority priority)
+    : stream(stream), priority(priority) {}
+
+SpdyWriteQueue::StreamWrites::~StreamWrites() = default;
+
 SpdyWriteQueue::SpdyWriteQueue() : removing_writes_(false) {}
 
 SpdyWriteQueue::~SpdyWriteQueue() {
@@ -52,8 +57,10 @@ SpdyWriteQueue::~SpdyWriteQueue() {
 }
 
 bool SpdyWriteQueue::IsEmpty() const {
+  if (!stream_writes_.empty())
+    return false;
   for (int i = MINIMUM_PRIORITY; i <= MAXIMUM_PRIORITY; i++) {
-    if (!queue_[i].empty())
+    if (!session_writes_[i].empty())
       return false;
   }
   return true;
@@ -68,11 +75,24 @@ void SpdyWriteQueue::Enqueue(
   CHECK(!removing_writes_);
   CHECK_GE(priority, MINIMUM_PRIORITY);
   CHECK_LE(priority, MAXIMUM_PRIORITY);
-  if (stream.get())
+  PendingWrite pending_write(
+      frame_type, std::move(frame_producer), stream,
+      MutableNetworkTrafficAnnotationTag(traffic_annotation));
+  if (stream.get()) {
     DCHECK_EQ(stream->priority(), priority);
-  queue_[priority].push_back(
-      {frame_type, std::move(frame_producer), stream,
-       MutableNetworkTrafficAnnotationTag(traffic_annotation)});
+    std::unique_ptr<StreamWrites>& stream_writes =
+        stream_writes_[stream.get()];
+    if (!stream_writes) {
+      stream_writes =
+          std::make_unique<StreamWrites>(stream.get(), priority);
+      ready_streams_[priority].Append(stream_writes.get());
+    }
+    DCHECK_EQ(stream_writes->priority, priority);
+    stream_writes->writes.push_back(std::move(pending_write));
+  } else {
+    session_writes_[priority].push_back(std::move(pending_write));
+  }
+  num_queued_frames_++;
   if (IsSpdyFrameTypeWriteCapped(frame_type)) {
     DCHECK_GE(num_queued_capped_frames_, 0);
     num_queued_capped_frames_++;
@@ -86,63 +106,87 @@ bool SpdyWriteQueue::Dequeue(
     MutableNetworkTrafficAnnotationTag* traffic_annotation) {
   CHECK(!removing_writes_);
   for (int i = MAXIMUM_PRIORITY; i >= MINIMUM_PRIORITY; --i) {
-    if (!queue_[i].empty()) {
-      PendingWrite pending_write = std::move(queue_[i].front());
-      queue_[i].pop_front();
-      *frame_type = pending_write.frame_type;
-      *frame_producer = std::move(pending_write.frame_producer);
-      *stream = pending_write.stream;
-      *traffic_annotation = pending_write.traffic_annotation;
-      if (pending_write.has_stream)
-        DCHECK(stream->get());
-      if (IsSpdyFrameTypeWriteCapped(*frame_type)) {
-        num_queued_capped_frames_--;
-        DCHECK_GE(num_queued_capped_frames_, 0);
-      }
-      return true;
+    PendingWrite pending_write;
+    if (!session_writes_[i].empty()) {
+      pending_write = std::move(session_writes_[i].front());
+      session_writes_[i].pop_front();
+    } else if (!ready_streams_[i].empty()) {
+      pending_write = DequeueStreamWrite(ready_streams_[i].head()->value());
+    } else {
+      continue;
+    }
+    *frame_type = pending_write.frame_type;
+    *frame_producer = std::move(pending_write.frame_producer);
+    *stream = pending_write.stream;
+    *traffic_annotation = pending_write.traffic_annotation;
+    if (pending_write.has_stream)
+      DCHECK(stream->get());
+    DCHECK_GT(num_queued_frames_, 0u);
+    num_queued_frames_--;
+    if (IsSpdyFrameTypeWriteCapped(*frame_type)) {
+      num_queued_capped_frames_--;
+      DCHECK_GE(num_queued_capped_frames_, 0);
     }
+    return true;
   }
   return false;
 }
 
+SpdyWriteQueue::PendingWrite SpdyWriteQueue::DequeueStreamWrite(
+    StreamWrites* stream_writes) {
+  DCHECK(!stream_writes->writes.empty());
+  PendingWrite pending_write = std::move(stream_writes->writes.front());
+  stream_writes->writes.pop_front();
+  stream_writes->RemoveFromList();
+  if (!stream_writes->writes.empty()) {
+    ready_streams_[stream_writes->priority].Append(stream_writes);
+  } else {
+    SpdyStream* stream = stream_writes->stream;
+    stream_writes_.erase(stream);
+  }
+  return pending_write;
+}
+
+void SpdyWriteQueue::EraseWrites(
+    base::circular_deque<PendingWrite>* writes,
+    std::vector<std::unique_ptr<SpdyBufferProducer>>* erased_producers) {
+  for (auto it = writes->begin(); it != writes->end(); ++it) {
+    if (IsSpdyFrameTypeWriteCapped(it->frame_type)) {
+      num_queued_capped_frames_--;
+      DCHECK_GE(num_queued_capped_frames_, 0);
+    }
+    erased_producers->push_back(std::move(it->frame_producer));
+  }
+  DCHECK_GE(num_queued_frames_, writes->size());
+  num_queued_frames_ -= writes->size();
+  writes->clear();
+}
+
 void SpdyWriteQueue::RemovePendingWritesForStream(SpdyStream* stream) {
   CHECK(!removing_writes_);
-  removing_writes_ = true;
   RequestPriority priority = stream->priority();
   CHECK_GE(priority, MINIMUM_PRIORITY);
   CHECK_LE(priority, MAXIMUM_PRIORITY);
 
-#if DCHECK_IS_ON()
+  auto it = stream_writes_.find(stream);
+  if (it == stream_writes_.end())
+    return;
   // |stream| should not have pending writes in a queue not matching
   // its priority.
-  for (int i = MINIMUM_PRIORITY; i <= MAXIMUM_PRIORITY; ++i) {
-    if (priority == i)
-      continue;
-    for (auto it = queue_[i].begin(); it != queue_[i].end(); ++it)
-      DCHECK_NE(it->stream.get(), stream);
-  }
-#endif
+  DCHECK_EQ(it->second->priority, priority);
 
-  // Defer deletion until queue iteration is complete, as
+  removing_writes_ = true;
+  // Defer deletion until the queue is consistent again, as
   // SpdyBuffer::~SpdyBuffer() can result in callbacks into SpdyWriteQueue.
   std::vector<std::unique_ptr<SpdyBufferProducer>> erased_buffer_producers;
-  base::circular_deque<PendingWrite>& queue = queue_[priority];
-  for (auto it = queue.begin(); it != queue.end();) {
-    if (it->stream.get() == stream) {
-      if (IsSpdyFrameTypeWriteCapped(it->frame_type)) {
-        num_queued_capped_frames_--;
-        DCHECK_GE(num_queued_capped_frames_, 0);
-      }
-      erased_buffer_producers.push_back(std::move(it->frame_producer));
-      it = queue.erase(it);
-    } else {
-      ++it;
-    }
-  }
+  std::unique_ptr<StreamWrites> stream_writes = std::move(it->second);
+  stream_writes_.erase(it);
+  stream_writes->RemoveFromList();
+  EraseWrites(&stream_writes->writes, &erased_buffer_producers);
   removing_writes_ = false;
 
-  // Iteration on |queue| is completed.  Now |erased_buffer_producers| goes out
-  // of scope, SpdyBufferProducers are destroyed.
+  // Now |erased_buffer_producers| goes out of scope, SpdyBufferProducers are
+  // destroyed.
 }
 
 void SpdyWriteQueue::RemovePendingWritesForStreamsAfter(
@@ -150,29 +194,24 @@ void SpdyWriteQueue::RemovePendingWritesForStreamsAfter(
   CHECK(!removing_writes_);
   removing_writes_ = true;
 
-  // Defer deletion until queue iteration is complete, as
+  // Defer deletion until map iteration is complete, as
   // SpdyBuffer::~SpdyBuffer() can result in callbacks into SpdyWriteQueue.
   std::vector<std::unique_ptr<SpdyBufferProducer>> erased_buffer_producers;
-  for (int i = MINIMUM_PRIORITY; i <= MAXIMUM_PRIORITY; ++i) {
-    base::circular_deque<PendingWrite>& queue = queue_[i];
-    for (auto it = queue.begin(); it != queue.end();) {
-      if (it->stream.get() && (it->stream->stream_id() > last_good_stream_id ||
-                               it->stream->stream_id() == 0)) {
-        if (IsSpdyFrameTypeWriteCapped(it->frame_type)) {
-          num_queued_capped_frames_--;
-          DCHECK_GE(num_queued_capped_frames_, 0);
-        }
-        erased_buffer_producers.push_back(std::move(it->frame_producer));
-        it = queue.erase(it);
-      } else {
-        ++it;
-      }
+  for (auto it = stream_writes_.begin(); it != stream_writes_.end();) {
+    SpdyStream* stream = it->second->writes.front().stream.get();
+    if (stream && (stream->stream_id() > last_good_stream_id ||
+                   stream->stream_id() == 0)) {
+      it->second->RemoveFromList();
+      EraseWrites(&it->second->writes, &erased_buffer_producers);
+      it = stream_writes_.erase(it);
+    } else {
+      ++it;
     }
   }
   removing_writes_ = false;
 
-  // Iteration on each |queue| is completed.  Now |erased_buffer_producers| goes
-  // out of scope, SpdyBufferProducers are destroyed.
+  // Iteration on |stream_writes_| is completed.  Now |erased_buffer_producers|
+  // goes out of scope, SpdyBufferProducers are destroyed.
 }
 
 void SpdyWriteQueue::ChangePriorityOfWritesForStream(
@@ -182,27 +221,16 @@ void SpdyWriteQueue::ChangePriorityOfWritesForStream(
   CHECK(!removing_writes_);
   DCHECK(stream);
 
-#if DCHECK_IS_ON()
+  auto it = stream_writes_.find(stream);
+  if (it == stream_writes_.end())
+    return;
   // |stream| should not have pending writes in a queue not matching
   // |old_priority|.
-  for (int i = MINIMUM_PRIORITY; i <= MAXIMUM_PRIORITY; ++i) {
-    if (i == old_priority)
-      continue;
-    for (auto it = queue_[i].begin(); it != queue_[i].end(); ++it)
-      DCHECK_NE(it->stream.get(), stream);
-  }
-#endif
-
-  base::circular_deque<PendingWrite>& old_queue = queue_[old_priority];
-  base::circular_deque<PendingWrite>& new_queue = queue_[new_priority];
-  for (auto it = old_queue.begin(); it != old_queue.end();) {
-    if (it->stream.get() == stream) {
-      new_queue.push_back(std::move(*it));
-      it = old_queue.erase(it);
-    } else {
-      ++it;
-    }
-  }
+  DCHECK_EQ(it->second->priority, old_priority);
+
+  it->second->RemoveFromList();
+  it->second->priority = new_priority;
+  ready_streams_[new_priority].Append(it->second.get());
 }
 
 void SpdyWriteQueue::Clear() {
@@ -211,12 +239,15 @@ void SpdyWriteQueue::Clear() {
   std::vector<std::unique_ptr<SpdyBufferProducer>> erased_buffer_producers;
 
   for (int i = MINIMUM_PRIORITY; i <= MAXIMUM_PRIORITY; ++i) {
-    for (auto it = queue_[i].begin(); it != queue_[i].end(); ++it) {
-      erased_buffer_producers.push_back(std::move(it->frame_producer));
-    }
-    queue_[i].clear();
+    EraseWrites(&session_writes_[i], &erased_buffer_producers);
+    while (!ready_streams_[i].empty())
+      ready_streams_[i].head()->RemoveFromList();
   }
+  for (auto it = stream_writes_.begin(); it != stream_writes_.end(); ++it)
+    EraseWrites(&it->second->writes, &erased_buffer_producers);
+  stream_writes_.clear();
   removing_writes_ = false;
+  DCHECK_EQ(num_queued_frames_, 0u);
   num_queued_capped_frames_ = 0;
 }
 
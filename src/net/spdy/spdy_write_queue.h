@@ -6,8 +6,11 @@
 #define NET_SPDY_SPDY_WRITE_QUEUE_H_
 
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "base/containers/circular_deque.h"
+#include "base/containers/linked_list.h"
 #include "base/memory/weak_ptr.h"
 #include "net/base/net_export.h"
 #include "net/base/request_priority.h"
@@ -25,7 +28,10 @@ class SpdyBufferProducer;
 class SpdyStream;
 
 // A queue of SpdyBufferProducers to produce frames to write. Ordered
-// by priority, and then FIFO.
+// by priority. Within a priority, writes not associated with a stream
+// go first in FIFO order, then streams take turns one frame at a time
+// so a bulk upload cannot delay the other streams at its priority by
+// more than a frame each. Writes of a single stream stay FIFO.
 class NET_EXPORT_PRIVATE SpdyWriteQueue {
  public:
   SpdyWriteQueue();
@@ -50,8 +56,8 @@ class NET_EXPORT_PRIVATE SpdyWriteQueue {
                const base::WeakPtr<SpdyStream>& stream,
                const NetworkTrafficAnnotationTag& traffic_annotation);
 
-  // Dequeues the frame producer with the highest priority that was
-  // enqueued the earliest and its associated stream. Returns true and
+  // Dequeues the next frame producer with the highest priority in the
+  // order described above and its associated stream. Returns true and
   // fills in |frame_type|, |frame_producer|, and |stream| if
   // successful -- otherwise, just returns false.
   bool Dequeue(spdy::SpdyFrameType* frame_type,
@@ -60,7 +66,7 @@ class NET_EXPORT_PRIVATE SpdyWriteQueue {
                MutableNetworkTrafficAnnotationTag* traffic_annotation);
 
   // Removes all pending writes for the given stream, which must be
-  // non-NULL.
+  // non-NULL. Takes constant time apart from destroying the writes.
   void RemovePendingWritesForStream(SpdyStream* stream);
 
   // Removes all pending writes for streams after |last_good_stream_id|
@@ -68,8 +74,8 @@ class NET_EXPORT_PRIVATE SpdyWriteQueue {
   void RemovePendingWritesForStreamsAfter(
       spdy::SpdyStreamId last_good_stream_id);
 
-  // Change priority of all pending writes for the given stream.  Frames will be
-  // queued after other writes with |new_priority|.
+  // Change priority of all pending writes for the given stream.  The stream
+  // takes its turn after the other streams with |new_priority|.
   void ChangePriorityOfWritesForStream(SpdyStream* stream,
                                        RequestPriority old_priority,
                                        RequestPriority new_priority);
@@ -81,6 +87,9 @@ class NET_EXPORT_PRIVATE SpdyWriteQueue {
   // priorities.
   int num_queued_capped_frames() const { return num_queued_capped_frames_; }
 
+  // Returns the number of currently queued frames including all priorities.
+  size_t num_queued_frames() const { return num_queued_frames_; }
+
  private:
   // A struct holding a frame producer and its associated stream.
   struct PendingWrite {
@@ -106,13 +115,45 @@ class NET_EXPORT_PRIVATE SpdyWriteQueue {
     ~PendingWrite();
   };
 
+  // The pending writes of one stream. Linked into the round-robin list of
+  // |priority| while it has any writes, and destroyed once it has none.
+  struct StreamWrites : public base::LinkNode<StreamWrites> {
+    StreamWrites(SpdyStream* stream, RequestPriority priority);
+    ~StreamWrites();
+
+    SpdyStream* const stream;
+    RequestPriority priority;
+    base::circular_deque<PendingWrite> writes;
+  };
+
+  // Pops the front write of |stream_writes| and gives the stream's turn to
+  // the next stream at its priority.
+  PendingWrite DequeueStreamWrite(StreamWrites* stream_writes);
+
+  // Moves the producers of |writes| to |erased_producers| and updates
+  // the capped frame count.
+  void EraseWrites(
+      base::circular_deque<PendingWrite>* writes,
+      std::vector<std::unique_ptr<SpdyBufferProducer>>* erased_producers);
+
   bool removing_writes_;
 
   // Number of currently queued capped frames including all priorities.
   int num_queued_capped_frames_ = 0;
 
-  // The actual write queue, binned by priority.
-  base::circular_deque<PendingWrite> queue_[NUM_PRIORITIES];
+  // Number of currently queued frames including all priorities.
+  size_t num_queued_frames_ = 0;
+
+  // Writes not associated with a stream, binned by priority.
+  base::circular_deque<PendingWrite> session_writes_[NUM_PRIORITIES];
+
+  // Writes associated with a stream, keyed by the stream.
+  std::unordered_map<SpdyStream*, std::unique_ptr<StreamWrites>>
+      stream_writes_;
+
+  // Streams with pending writes, binned by priority, in the order they take
+  // their turns.
+  base::LinkedList<StreamWrites> ready_streams_[NUM_PRIORITIES];
 };
 
 }  // namespace net
@@ -16,6 +16,7 @@
 #ifndef QUICHE_COMMON_QUICHE_LINKED_HASH_MAP_H_
 #define QUICHE_COMMON_QUICHE_LINKED_HASH_MAP_H_
 
+#include <cstddef>
 #include <functional>
 #include <list>
 #include <tuple>
@@ -35,12 +36,18 @@ namespace quiche {
 //
 // We also keep a set<list::iterator> for find.  Since std::list is a
 // doubly-linked list, the iterators should remain stable.
+//
+// If |kSmallSize| is nonzero, the set is not built until the map grows past
+// |kSmallSize| elements, and lookups in smaller maps scan the list instead.
+// This saves a hash node per element and the bucket array for maps that
+// usually stay small.  Once built, the set is kept until the map is cleared.
 
 // QUICHE_NO_EXPORT comments suppress erroneous presubmit failures.
 template <class Key,                      // QUICHE_NO_EXPORT
           class Value,                    // QUICHE_NO_EXPORT
           class Hash = absl::Hash<Key>,   // QUICHE_NO_EXPORT
-          class Eq = std::equal_to<Key>>  // QUICHE_NO_EXPORT
+          class Eq = std::equal_to<Key>,  // QUICHE_NO_EXPORT
+          size_t kSmallSize = 0>          // QUICHE_NO_EXPORT
 class QuicheLinkedHashMap {               // QUICHE_NO_EXPORT
  private:
   typedef std::list<std::pair<Key, Value>> ListType;
@@ -111,6 +118,15 @@ class QuicheLinkedHashMap {               // QUICHE_NO_EXPORT
   // Erases values with the provided key.  Returns the number of elements
   // erased.  In this implementation, this will be 0 or 1.
   size_type erase(const Key& key) {
+    if (!indexed()) {
+      iterator position = FindInList(key);
+      if (position == end()) {
+        return 0;
+      }
+      list_.erase(position);
+      return 1;
+    }
+
     typename MapType::iterator found = map_.find(key);
     if (found == map_.end()) {
       return 0;
@@ -128,6 +144,10 @@ class QuicheLinkedHashMap {               // QUICHE_NO_EXPORT
   // If the provided iterator is invalid or there is inconsistency between the
   // map and list, a QUICHE_CHECK() error will occur.
   iterator erase(iterator position) {
+    if (!indexed()) {
+      return list_.erase(position);
+    }
+
     typename MapType::iterator found = map_.find(position->first);
     QUICHE_CHECK(found->second == position)
         << "Inconsistent iterator for map and list, or the iterator is "
@@ -151,6 +171,9 @@ class QuicheLinkedHashMap {               // QUICHE_NO_EXPORT
   // value found, or to end() if the value was not found.  Like a map, this
   // iterator points to a pair<Key, Value>.
   iterator find(const Key& key) {
+    if (!indexed()) {
+      return FindInList(key);
+    }
     typename MapType::iterator found = map_.find(key);
     if (found == map_.end()) {
       return end();
@@ -159,6 +182,9 @@ class QuicheLinkedHashMap {               // QUICHE_NO_EXPORT
   }
 
   const_iterator find(const Key& key) const {
+    if (!indexed()) {
+      return FindInList(key);
+    }
     typename MapType::const_iterator found = map_.find(key);
     if (found == map_.end()) {
       return end();
@@ -184,8 +210,8 @@ class QuicheLinkedHashMap {               // QUICHE_NO_EXPORT
     return InsertInternal(std::move(pair));
   }
 
-  // Derive size_ from map_, as list::size might be O(N).
-  size_type size() const { return map_.size(); }
+  // list::size is constant time since C++11, and map_ may not be built.
+  size_type size() const { return list_.size(); }
 
   template <typename... Args>
   std::pair<iterator, bool> emplace(Args&&... args) {
@@ -193,6 +219,14 @@ class QuicheLinkedHashMap {               // QUICHE_NO_EXPORT
     auto node_pos =
         node_donor.emplace(node_donor.end(), std::forward<Args>(args)...);
     const auto& k = node_pos->first;
+    if (PrepareInsert()) {
+      iterator found = FindInList(k);
+      if (found != end()) {
+        return {found, false};
+      }
+      list_.splice(list_.end(), node_donor, node_pos);
+      return {node_pos, true};
+    }
     auto ins = map_.insert({k, node_pos});
     if (!ins.second) {
       return {ins.first->second, false};
@@ -207,8 +241,56 @@ class QuicheLinkedHashMap {               // QUICHE_NO_EXPORT
   }
 
  private:
+  // Returns true once the lookup set has been built.  It is built whenever
+  // the map has more than |kSmallSize| elements.
+  bool indexed() const { return !map_.empty(); }
+
+  iterator FindInList(const Key& key) {
+    const Eq& eq = map_.key_eq();
+    for (iterator it = list_.begin(); it != list_.end(); ++it) {
+      if (eq(it->first, key)) {
+        return it;
+      }
+    }
+    return list_.end();
+  }
+
+  const_iterator FindInList(const Key& key) const {
+    const Eq& eq = map_.key_eq();
+    for (const_iterator it = list_.begin(); it != list_.end(); ++it) {
+      if (eq(it->first, key)) {
+        return it;
+      }
+    }
+    return list_.end();
+  }
+
+  // Called before inserting one element.  Returns true if the map is still
+  // small enough to be searched linearly; otherwise builds the lookup set if
+  // it is missing.
+  bool PrepareInsert() {
+    if (indexed()) {
+      return false;
+    }
+    if (list_.size() < kSmallSize) {
+      return true;
+    }
+    for (iterator it = list_.begin(); it != list_.end(); ++it) {
+      map_.emplace(it->first, it);
+    }
+    return false;
+  }
+
   template <typename U>
   std::pair<iterator, bool> InsertInternal(U&& pair) {
+    if (PrepareInsert()) {
+      iterator found = FindInList(pair.first);
+      if (found != end()) {
+        return {found, false};
+      }
+      return {list_.insert(list_.end(), std::forward<U>(pair)), true};
+    }
+
     auto insert_result = map_.try_emplace(pair.first);
     auto map_iter = insert_result.first;
 
@@ -225,7 +307,8 @@ class QuicheLinkedHashMap {               // QUICHE_NO_EXPORT
     return {list_iter, true};
   }
 
-  // The map component, used for speedy lookups
+  // The map component, used for speedy lookups.  Empty while the map has at
+  // most |kSmallSize| elements.
   MapType map_;
 
   // The list component, used for maintaining insertion order
@@ -4,9 +4,12 @@
 
 #include "http2/hpack/huffman/hpack_huffman_decoder.h"
 
+#include <string.h>
+
 #include <bitset>
 #include <limits>
 
+#include "common/quiche_endian.h"
 #include "http2/platform/api/http2_logging.h"
 
 // Terminology:
@@ -343,6 +346,48 @@ struct ShortCodeInfo {
     {0x7a, 7},  // Match: 0b1111011, Symbol: z
 };
 
+// Number of leading bits looked up at once in the multi-symbol table. Every
+// code of up to this many bits decodes with one lookup, and so does a pair of
+// codes whose lengths add up to at most this many bits, e.g. two lowercase
+// letters or digits.
+constexpr HuffmanAccumulatorBitCount kMultiSymbolBitCount = 12;
+constexpr size_t kMultiSymbolTableSize = 1 << kMultiSymbolBitCount;
+
+// The symbols encoded by a run of kMultiSymbolBitCount leading bits.
+struct MultiSymbolInfo {
+  uint8_t symbols[2];
+  // Zero if the first code is longer than kMultiSymbolBitCount.
+  uint8_t symbol_count;
+  // Number of bits taken by the codes of |symbols|.
+  uint8_t length;
+};
+
+// Built from PrefixToInfo on first use; 16 KiB.
+const MultiSymbolInfo* GetMultiSymbolTable() {
+  static const MultiSymbolInfo* const table = [] {
+    auto* table = new MultiSymbolInfo[kMultiSymbolTableSize]();
+    for (HuffmanCode i = 0; i < kMultiSymbolTableSize; ++i) {
+      MultiSymbolInfo& info = table[i];
+      HuffmanCode bits = i << (kHuffmanCodeBitCount - kMultiSymbolBitCount);
+      while (info.symbol_count < 2) {
+        // The code is prefix free, so the trailing zeros shifted in below
+        // never change which code a run of leading bits starts with.
+        PrefixInfo prefix_info = PrefixToInfo(bits);
+        if (info.length + prefix_info.code_length > kMultiSymbolBitCount) {
+          break;
+        }
+        // EOS is 30 bits long and never fits.
+        uint32_t canonical = prefix_info.DecodeToCanonical(bits);
+        info.symbols[info.symbol_count++] = kCanonicalToSymbol[canonical];
+        info.length += prefix_info.code_length;
+        bits <<= prefix_info.code_length;
+      }
+    }
+    return table;
+  }();
+  return table;
+}
+
 }  // namespace
 
 HuffmanBitBuffer::HuffmanBitBuffer() {
@@ -361,6 +406,10 @@ size_t HuffmanBitBuffer::AppendBytes(absl::string_view input) {
     return 0;
   }
 
+  if (bytes_available >= sizeof(HuffmanAccumulator)) {
+    return AppendWord(input);
+  }
+
   // Top up |accumulator_| until there isn't room for a whole byte.
   size_t bytes_used = 0;
   auto* ptr = reinterpret_cast<const uint8_t*>(input.data());
@@ -374,6 +423,23 @@ size_t HuffmanBitBuffer::AppendBytes(absl::string_view input) {
   return bytes_used;
 }
 
+size_t HuffmanBitBuffer::AppendWord(absl::string_view input) {
+  QUICHE_DCHECK_GE(input.size(), sizeof(HuffmanAccumulator));
+  HuffmanAccumulatorBitCount free_cnt = free_count();
+  size_t bytes_used = free_cnt / 8;
+  if (bytes_used == 0) {
+    return 0;
+  }
+  HuffmanAccumulator word;
+  memcpy(&word, input.data(), sizeof(word));
+  word = quiche::QuicheEndian::NetToHost64(word);
+  // Keep the leading |bytes_used| bytes of |word|.
+  word >>= kHuffmanAccumulatorBitCount - bytes_used * 8;
+  accumulator_ |= word << (free_cnt - bytes_used * 8);
+  count_ += bytes_used * 8;
+  return bytes_used;
+}
+
 HuffmanAccumulatorBitCount HuffmanBitBuffer::free_count() const {
   return kHuffmanAccumulatorBitCount - count_;
 }
@@ -415,10 +481,51 @@ HpackHuffmanDecoder::~HpackHuffmanDecoder() = default;
 bool HpackHuffmanDecoder::Decode(absl::string_view input, std::string* output) {
   HTTP2_DVLOG(1) << "HpackHuffmanDecoder::Decode";
 
+  const MultiSymbolInfo* multi_symbol_table = GetMultiSymbolTable();
+
+  // Every code is at least kMinCodeBitCount bits long, which bounds the
+  // number of symbols decoded here. Symbols are written through |out|, which
+  // is cheaper than push_back, and |output| is trimmed on return. One spare
+  // byte lets a pair of symbols always be written at once.
+  const size_t original_size = output->size();
+  output->resize(original_size +
+                 (bit_buffer_.count() + input.size() * 8) / kMinCodeBitCount +
+                 1);
+  char* const first = &*output->begin() + original_size;
+  char* out = first;
+
   // Fill bit_buffer_ from input.
   input.remove_prefix(bit_buffer_.AppendBytes(input));
 
   while (true) {
+    // While a whole word of input remains, decode the codes that fit in the
+    // multi-symbol table. This works on a local copy of the bit buffer so
+    // that it stays in registers instead of being reloaded after every
+    // symbol written through |out|.
+    HuffmanBitBuffer bit_buffer = bit_buffer_;
+    while (true) {
+      if (bit_buffer.count() < kMultiSymbolBitCount) {
+        if (input.size() < sizeof(HuffmanAccumulator)) {
+          break;
+        }
+        input.remove_prefix(bit_buffer.AppendWord(input));
+      }
+      const MultiSymbolInfo& info =
+          multi_symbol_table[bit_buffer.value() >>
+                             (kHuffmanAccumulatorBitCount -
+                              kMultiSymbolBitCount)];
+      if (info.symbol_count == 0) {
+        break;
+      }
+      out[0] = static_cast<char>(info.symbols[0]);
+      out[1] = static_cast<char>(info.symbols[1]);
+      out += info.symbol_count;
+      bit_buffer.ConsumeBits(info.length);
+    }
+    bit_buffer_ = bit_buffer;
+
+    // Otherwise decode one symbol at a time: a code longer than the
+    // multi-symbol table, or the last few bytes of input.
     HTTP2_DVLOG(3) << "Enter Decode Loop, bit_buffer_: " << bit_buffer_;
     if (bit_buffer_.count() >= 7) {
       // Get high 7 bits of the bit buffer, see if that contains a complete
@@ -429,14 +536,14 @@ bool HpackHuffmanDecoder::Decode(absl::string_view input, std::string* output) {
       if (short_code < kShortCodeTableSize) {
         ShortCodeInfo info = kShortCodeTable[short_code];
         bit_buffer_.ConsumeBits(info.length);
-        output->push_back(static_cast<char>(info.symbol));
+        *out++ = static_cast<char>(info.symbol);
         continue;
       }
       // The code is more than 7 bits long. Use PrefixToInfo, etc. to decode
       // longer codes.
     } else {
       // We may have (mostly) drained bit_buffer_. If we can top it up, try
-      // using the table decoder above.
+      // using the table decoders above.
       size_t byte_count = bit_buffer_.AppendBytes(input);
       if (byte_count > 0) {
         input.remove_prefix(byte_count);
@@ -457,14 +564,14 @@ bool HpackHuffmanDecoder::Decode(absl::string_view input, std::string* output) {
       uint32_t canonical = prefix_info.DecodeToCanonical(code_prefix);
       if (canonical < 256) {
         // Valid code.
-        char c = kCanonicalToSymbol[canonical];
-        output->push_back(c);
+        *out++ = kCanonicalToSymbol[canonical];
         bit_buffer_.ConsumeBits(prefix_info.code_length);
         continue;
       }
       // Encoder is not supposed to explicity encode the EOS symbol.
       HTTP2_DLOG(ERROR) << "EOS explicitly encoded!\n " << bit_buffer_ << "\n "
                         << prefix_info;
+      output->resize(original_size + (out - first));
       return false;
     }
     // bit_buffer_ doesn't have enough bits in it to decode the next symbol.
@@ -472,6 +579,7 @@ bool HpackHuffmanDecoder::Decode(absl::string_view input, std::string* output) {
     size_t byte_count = bit_buffer_.AppendBytes(input);
     if (byte_count == 0) {
       QUICHE_DCHECK_EQ(input.size(), 0u);
+      output->resize(original_size + (out - first));
       return true;
     }
     input.remove_prefix(byte_count);
@@ -49,6 +49,10 @@ class QUICHE_EXPORT_PRIVATE HuffmanBitBuffer {
   // returning the number of bytes added.
   size_t AppendBytes(absl::string_view input);
 
+  // Like AppendBytes, but |input| must hold at least
+  // sizeof(HuffmanAccumulator) bytes, so they are loaded all at once.
+  size_t AppendWord(absl::string_view input);
+
   // Get the bits of the accumulator.
   HuffmanAccumulator value() const { return accumulator_; }
 
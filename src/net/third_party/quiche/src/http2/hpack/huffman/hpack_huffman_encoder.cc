@@ -70,60 +70,45 @@ void HuffmanEncodeFast(absl::string_view input,
                        std::string* output) {
   const size_t original_size = output->size();
   const size_t final_size = original_size + encoded_size;
-  // Reserve an extra four bytes to avoid accessing unallocated memory (even
-  // though it would only be OR'd with zeros and thus not modified).
-  output->resize(final_size + 4, 0);
+  output->resize(final_size);
 
-  // Pointer to first appended byte.
-  char* const first = &*output->begin() + original_size;
-  size_t bit_counter = 0;
+  // Pointer to next byte to be written.
+  char* current = &*output->begin() + original_size;
+  // Codes are shifted in at the low end of |bit_buffer|, and the low
+  // |bit_count| bits of it are still to be written. Whole 32-bit words are
+  // written at once, so at most 31 bits are left over before adding a code,
+  // and the longest code is 30 bits long, so nothing is shifted out that
+  // hasn't been written.
+  uint64_t bit_buffer = 0;
+  size_t bit_count = 0;
   for (uint8_t c : input) {
-    // Align the Huffman code to byte boundaries as it needs to be written.
-    // The longest Huffman code is 30 bits long, and it can be shifted by up to
-    // 7 bits, requiring 37 bits in total.  The most significant 25 bits and
-    // least significant 2 bits of |code| are always zero.
-    uint64_t code = static_cast<uint64_t>(HuffmanSpecTables::kLeftCodes[c])
-                    << (8 - (bit_counter % 8));
-    // The byte where the first bit of |code| needs to be written.
-    char* const current = first + (bit_counter / 8);
-
-    bit_counter += HuffmanSpecTables::kCodeLengths[c];
-
-    *current |= code >> 32;
-
-    // Do not check if this write is zero before executing it, because with
-    // uniformly random shifts and an ideal random input distribution
-    // corresponding to the Huffman tree it would only be zero in 29% of the
-    // cases.
-    *(current + 1) |= (code >> 24) & 0xff;
-
-    // Continue to next input character if there is nothing else to write.
-    // (If next byte is zero, then rest must also be zero.)
-    if ((code & 0xff0000) == 0) {
-      continue;
+    bit_buffer = (bit_buffer << HuffmanSpecTables::kCodeLengths[c]) |
+                 HuffmanSpecTables::kRightCodes[c];
+    bit_count += HuffmanSpecTables::kCodeLengths[c];
+    if (bit_count >= 32) {
+      bit_count -= 32;
+      uint32_t word = static_cast<uint32_t>(bit_buffer >> bit_count);
+      current[0] = static_cast<char>(word >> 24);
+      current[1] = static_cast<char>(word >> 16);
+      current[2] = static_cast<char>(word >> 8);
+      current[3] = static_cast<char>(word);
+      current += 4;
     }
-    *(current + 2) |= (code >> 16) & 0xff;
-
-    // Continue to next input character if there is nothing else to write.
-    // (If next byte is zero, then rest must also be zero.)
-    if ((code & 0xff00) == 0) {
-      continue;
-    }
-    *(current + 3) |= (code >> 8) & 0xff;
-
-    // Do not check if this write is zero, because the check would probably be
-    // as expensive as the write.
-    *(current + 4) |= code & 0xff;
   }
-
-  QUICHE_DCHECK_EQ(encoded_size, (bit_counter + 7) / 8);
+  while (bit_count >= 8) {
+    bit_count -= 8;
+    *current++ = static_cast<char>(bit_buffer >> bit_count);
+  }
 
   // EOF
-  if (bit_counter % 8 != 0) {
-    *(first + encoded_size - 1) |= 0xff >> (bit_counter & 7);
+  if (bit_count > 0) {
+    // Pad out the final byte with the leading bits of the EOS symbol, which
+    // are all 1 bits.
+    *current++ = static_cast<char>((bit_buffer << (8 - bit_count)) |
+                                   (0xff >> bit_count));
   }
 
-  output->resize(final_size);
+  QUICHE_DCHECK_EQ(current, &*output->begin() + final_size);
 }
 
 }  // namespace http2
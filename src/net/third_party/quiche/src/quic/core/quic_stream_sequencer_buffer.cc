@@ -8,9 +8,11 @@
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "common/platform/api/quiche_thread_local.h"
 #include "quic/core/quic_constants.h"
 #include "quic/core/quic_interval.h"
 #include "quic/platform/api/quic_bug_tracker.h"
@@ -38,6 +40,42 @@ constexpr size_t kInitialBlockCount = 8u;
 // Choose 4 to reduce the amount of reallocation.
 constexpr int kBlocksGrowthFactor = 4;
 
+// Retired blocks are kept on a per-thread free list so that streams churning
+// through data do not malloc and free a block for every 8KB received. At most
+// kMaxFreeBlocksPerThread blocks are retained; the rest are freed.
+constexpr size_t kMaxFreeBlocksPerThread = 64u;
+
+using BlockFreeList =
+    std::vector<std::unique_ptr<QuicStreamSequencerBuffer::BufferBlock>>;
+
+DEFINE_QUICHE_THREAD_LOCAL_POINTER(FreeBlocks, BlockFreeList);
+
+QuicStreamSequencerBuffer::BufferBlock* AllocateBlock() {
+  BlockFreeList* free_blocks = GET_QUICHE_THREAD_LOCAL_POINTER(FreeBlocks);
+  if (free_blocks == nullptr || free_blocks->empty()) {
+    return new QuicStreamSequencerBuffer::BufferBlock();
+  }
+  QuicStreamSequencerBuffer::BufferBlock* block =
+      free_blocks->back().release();
+  free_blocks->pop_back();
+  return block;
+}
+
+void FreeBlock(QuicStreamSequencerBuffer::BufferBlock* block) {
+  BlockFreeList* free_blocks = GET_QUICHE_THREAD_LOCAL_POINTER(FreeBlocks);
+  if (free_blocks == nullptr) {
+    // Never freed, but holds at most kMaxFreeBlocksPerThread blocks.
+    free_blocks = new BlockFreeList();
+    free_blocks->reserve(kMaxFreeBlocksPerThread);
+    SET_QUICHE_THREAD_LOCAL_POINTER(FreeBlocks, free_blocks);
+  }
+  if (free_blocks->size() >= kMaxFreeBlocksPerThread) {
+    delete block;
+    return;
+  }
+  free_blocks->emplace_back(block);
+}
+
 }  // namespace
 
 QuicStreamSequencerBuffer::QuicStreamSequencerBuffer(size_t max_capacity_bytes)
@@ -72,7 +110,7 @@ bool QuicStreamSequencerBuffer::RetireBlock(size_t index) {
     QUIC_BUG(quic_bug_10610_1) << "Try to retire block twice";
     return false;
   }
-  delete blocks_[index];
+  FreeBlock(blocks_[index]);
   blocks_[index] = nullptr;
   QUIC_DVLOG(1) << "Retired block with index: " << index;
   return true;
@@ -232,9 +270,7 @@ bool QuicStreamSequencerBuffer::CopyStreamData(QuicStreamOffset offset,
       return false;
     }
     if (blocks_[write_block_num] == nullptr) {
-      // TODO(danzh): Investigate if using a freelist would improve performance.
-      // Same as RetireBlock().
-      blocks_[write_block_num] = new BufferBlock();
+      blocks_[write_block_num] = AllocateBlock();
     }
 
     const size_t bytes_to_copy =
@@ -15,14 +15,6 @@
 namespace spdy {
 namespace {
 
-// By default, linked_hash_map's internal map allocates space for 100 map
-// buckets on construction, which is larger than necessary.  Standard library
-// unordered map implementations use a list of prime numbers to set the bucket
-// count for a particular capacity.  |kInitialMapBuckets| is chosen to reduce
-// memory usage for small header blocks, at the cost of having to rehash for
-// large header blocks.
-const size_t kInitialMapBuckets = 11;
-
 const char kCookieKey[] = "cookie";
 const char kNullSeparator = 0;
 
@@ -173,10 +165,9 @@ std::string Http2HeaderBlock::ValueProxy::as_string() const {
   }
 }
 
-Http2HeaderBlock::Http2HeaderBlock() : map_(kInitialMapBuckets) {}
+Http2HeaderBlock::Http2HeaderBlock() = default;
 
-Http2HeaderBlock::Http2HeaderBlock(Http2HeaderBlock&& other)
-    : map_(kInitialMapBuckets) {
+Http2HeaderBlock::Http2HeaderBlock(Http2HeaderBlock&& other) {
   map_.swap(other.map_);
   storage_ = std::move(other.storage_);
   for (auto& p : map_) {
@@ -23,7 +23,7 @@ void SpdyHeaderStorage::Rewind(const absl::string_view s) {
 }
 
 absl::string_view SpdyHeaderStorage::WriteFragments(
-    const std::vector<absl::string_view>& fragments,
+    absl::Span<const absl::string_view> fragments,
     absl::string_view separator) {
   if (fragments.empty()) {
     return absl::string_view();
@@ -39,7 +39,7 @@ absl::string_view SpdyHeaderStorage::WriteFragments(
 }
 
 size_t Join(char* dst,
-            const std::vector<absl::string_view>& fragments,
+            absl::Span<const absl::string_view> fragments,
             absl::string_view separator) {
   if (fragments.empty()) {
     return 0;
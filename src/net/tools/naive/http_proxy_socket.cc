@@ -19,11 +19,11 @@
 #include "net/log/net_log.h"
 #include "net/third_party/quiche/src/spdy/core/hpack/hpack_constants.h"
 #include "net/tools/naive/naive_proxy_delegate.h"
+#include "net/tools/naive/relay_buffer_pool.h"
 
 namespace net {
 
 namespace {
-constexpr int kBufferSize = 64 * 1024;
 constexpr size_t kMaxHeaderSize = 64 * 1024;
 constexpr char kResponseHeader[] = "HTTP/1.1 200 OK\r\nPadding: ";
 constexpr int kResponseHeaderSize = sizeof(kResponseHeader) - 1;
@@ -35,11 +35,13 @@ constexpr int kMaxPaddingSize = kMinPaddingSize + 32;
 HttpProxySocket::HttpProxySocket(
     std::unique_ptr<StreamSocket> transport_socket,
     ClientPaddingDetectorDelegate* padding_detector_delegate,
+    RelayBufferPool* buffer_pool,
     const NetworkTrafficAnnotationTag& traffic_annotation)
     : io_callback_(base::BindRepeating(&HttpProxySocket::OnIOComplete,
                                        base::Unretained(this))),
       transport_(std::move(transport_socket)),
       padding_detector_delegate_(padding_detector_delegate),
+      buffer_pool_(buffer_pool),
       next_state_(STATE_NONE),
       completed_handshake_(false),
       was_ever_used_(false),
@@ -259,8 +261,9 @@ int HttpProxySocket::DoLoop(int last_io_result) {
 int HttpProxySocket::DoHeaderRead() {
   next_state_ = STATE_HEADER_READ_COMPLETE;
 
-  handshake_buf_ = base::MakeRefCounted<IOBuffer>(kBufferSize);
-  return transport_->Read(handshake_buf_.get(), kBufferSize, io_callback_);
+  handshake_buf_ = buffer_pool_->Get(RelayBufferPool::kMinBufferSize);
+  return transport_->Read(handshake_buf_.get(), RelayBufferPool::kMinBufferSize,
+                          io_callback_);
 }
 
 int HttpProxySocket::DoHeaderReadComplete(int result) {
@@ -272,6 +275,7 @@ int HttpProxySocket::DoHeaderReadComplete(int result) {
   }
 
   buffer_.append(handshake_buf_->data(), result);
+  handshake_buf_ = nullptr;
   if (buffer_.size() > kMaxHeaderSize) {
     return ERR_MSG_TOO_BIG;
   }
@@ -26,12 +26,14 @@
 namespace net {
 struct NetworkTrafficAnnotationTag;
 class ClientPaddingDetectorDelegate;
+class RelayBufferPool;
 
 // This StreamSocket is used to setup a HTTP CONNECT tunnel.
 class HttpProxySocket : public StreamSocket {
  public:
   HttpProxySocket(std::unique_ptr<StreamSocket> transport_socket,
                   ClientPaddingDetectorDelegate* padding_detector_delegate,
+                  RelayBufferPool* buffer_pool,
                   const NetworkTrafficAnnotationTag& traffic_annotation);
   HttpProxySocket(const HttpProxySocket&) = delete;
   HttpProxySocket& operator=(const HttpProxySocket&) = delete;
@@ -97,6 +99,7 @@ class HttpProxySocket : public StreamSocket {
   // Stores the underlying socket.
   std::unique_ptr<StreamSocket> transport_;
   ClientPaddingDetectorDelegate* padding_detector_delegate_;
+  RelayBufferPool* buffer_pool_;
 
   State next_state_;
 
@@ -0,0 +1,192 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "net/tools/naive/io_thread_monitor.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/metrics/histogram.h"
+#include "base/no_destructor.h"
+#include "base/pending_task.h"
+#include "base/strings/strcat.h"
+#include "base/strings/stringprintf.h"
+#include "base/task/current_thread.h"
+#include "base/threading/thread_local.h"
+#include "base/threading/thread_task_runner_handle.h"
+
+namespace net {
+
+namespace {
+constexpr base::TimeDelta kProbeInterval = base::Milliseconds(100);
+constexpr base::TimeDelta kReportInterval = base::Seconds(60);
+// A thread whose probe runs this late has work queued behind it long enough
+// for users to notice.
+constexpr base::TimeDelta kSaturatedLag = base::Milliseconds(100);
+constexpr int32_t kHistogramFlags =
+    base::HistogramBase::kUmaTargetedHistogramFlag;
+
+// The started monitor of the current thread, if any.
+base::ThreadLocalPointer<IOThreadMonitor>& GetCurrentMonitor() {
+  static base::NoDestructor<base::ThreadLocalPointer<IOThreadMonitor>>
+      current;
+  return *current;
+}
+
+// Histograms are shared by all IO threads and looked up once.
+base::HistogramBase* GetLagHistogram() {
+  static base::HistogramBase* histogram = base::Histogram::FactoryTimeGet(
+      "Naive.IOThread.Lag", base::Milliseconds(1), base::Seconds(10), 50,
+      kHistogramFlags);
+  return histogram;
+}
+
+base::HistogramBase* GetQueueingTimeHistogram() {
+  static base::HistogramBase* histogram =
+      base::Histogram::FactoryMicrosecondsTimeGet(
+          "Naive.IOThread.QueueingTime", base::Microseconds(1),
+          base::Seconds(10), 50, kHistogramFlags);
+  return histogram;
+}
+
+base::HistogramBase* GetYieldsHistogram() {
+  static base::HistogramBase* histogram = base::Histogram::FactoryGet(
+      "Naive.IOThread.YieldsPerSecond", 1, 100000, 50, kHistogramFlags);
+  return histogram;
+}
+}  // namespace
+
+IOThreadMonitor::IOThreadMonitor(const std::string& thread_name)
+    : thread_name_(thread_name),
+      started_(false),
+      num_tasks_(0),
+      num_yields_(0),
+      last_external_yields_(0) {}
+
+IOThreadMonitor::~IOThreadMonitor() {
+  if (started_) {
+    base::CurrentThread::Get()->RemoveTaskObserver(this);
+    GetCurrentMonitor().Set(nullptr);
+  }
+}
+
+void IOThreadMonitor::Start() {
+  DCHECK(!started_);
+  DCHECK(!GetCurrentMonitor().Get());
+  started_ = true;
+  GetCurrentMonitor().Set(this);
+  // Stamps posted tasks with their queue time for QueueingTime.
+  base::CurrentThread::Get()->SetAddQueueTimeToTasks(true);
+  base::CurrentThread::Get()->AddTaskObserver(this);
+  report_start_time_ = base::TimeTicks::Now();
+  report_timer_.Start(FROM_HERE, kReportInterval,
+                      base::BindRepeating(&IOThreadMonitor::Report,
+                                          base::Unretained(this)));
+  PostProbe();
+}
+
+// static
+void IOThreadMonitor::RecordYield() {
+  IOThreadMonitor* monitor = GetCurrentMonitor().Get();
+  if (monitor)
+    ++monitor->num_yields_;
+}
+
+void IOThreadMonitor::SetExternalYieldsCallback(
+    base::RepeatingCallback<int64_t()> callback) {
+  external_yields_callback_ = std::move(callback);
+  last_external_yields_ = external_yields_callback_.Run();
+}
+
+void IOThreadMonitor::WillProcessTask(const base::PendingTask& pending_task,
+                                      bool was_blocked_or_low_priority) {
+  task_start_time_ = base::TimeTicks::Now();
+  if (!pending_task.queue_time.is_null() &&
+      pending_task.delayed_run_time.is_null()) {
+    base::TimeDelta queueing_time = task_start_time_ - pending_task.queue_time;
+    GetQueueingTimeHistogram()->AddTimeMicrosecondsGranularity(queueing_time);
+    max_queueing_time_ = std::max(max_queueing_time_, queueing_time);
+  }
+}
+
+void IOThreadMonitor::DidProcessTask(const base::PendingTask& pending_task) {
+  base::TimeDelta task_time = base::TimeTicks::Now() - task_start_time_;
+  GetTaskTimeHistogram(nullptr)->AddTimeMicrosecondsGranularity(task_time);
+  GetTaskTimeHistogram(pending_task.posted_from.function_name())
+      ->AddTimeMicrosecondsGranularity(task_time);
+  total_task_time_ += task_time;
+  ++num_tasks_;
+}
+
+void IOThreadMonitor::PostProbe() {
+  base::ThreadTaskRunnerHandle::Get()->PostDelayedTask(
+      FROM_HERE,
+      base::BindOnce(&IOThreadMonitor::OnProbe, weak_ptr_factory_.GetWeakPtr(),
+                     base::TimeTicks::Now() + kProbeInterval),
+      kProbeInterval);
+}
+
+void IOThreadMonitor::OnProbe(base::TimeTicks expected_time) {
+  base::TimeDelta lag =
+      std::max(base::TimeTicks::Now() - expected_time, base::TimeDelta());
+  GetLagHistogram()->AddTime(lag);
+  max_lag_ = std::max(max_lag_, lag);
+  PostProbe();
+}
+
+void IOThreadMonitor::Report() {
+  base::TimeTicks now = base::TimeTicks::Now();
+  base::TimeDelta elapsed = now - report_start_time_;
+  if (external_yields_callback_) {
+    int64_t external_yields = external_yields_callback_.Run();
+    num_yields_ += external_yields - last_external_yields_;
+    last_external_yields_ = external_yields;
+  }
+  int64_t yields_per_second =
+      num_yields_ / std::max<int64_t>(elapsed.InSeconds(), 1);
+  GetYieldsHistogram()->Add(yields_per_second);
+
+  // Busy time only counts posted tasks; IO callbacks run by the message pump
+  // show up in the lag instead.
+  int busy_percent = 0;
+  if (!elapsed.is_zero())
+    busy_percent = static_cast<int>(total_task_time_ * 100 / elapsed);
+  std::string summary = base::StringPrintf(
+      "IO thread %s: max lag %" PRId64 " ms, max queueing %" PRId64
+      " ms, %" PRId64 " tasks, %d%% busy, %" PRId64 " yields/s",
+      thread_name_.c_str(), max_lag_.InMilliseconds(),
+      max_queueing_time_.InMilliseconds(), num_tasks_, busy_percent,
+      yields_per_second);
+  if (max_lag_ >= kSaturatedLag) {
+    LOG(INFO) << summary << " (saturated)";
+  } else {
+    VLOG(1) << summary;
+  }
+
+  report_start_time_ = now;
+  max_lag_ = base::TimeDelta();
+  max_queueing_time_ = base::TimeDelta();
+  total_task_time_ = base::TimeDelta();
+  num_tasks_ = 0;
+  num_yields_ = 0;
+}
+
+base::HistogramBase* IOThreadMonitor::GetTaskTimeHistogram(
+    const char* function_name) {
+  auto it = task_time_histograms_.find(function_name);
+  if (it != task_time_histograms_.end())
+    return it->second;
+  std::string name = "Naive.IOThread.TaskTime";
+  if (function_name)
+    name = base::StrCat({name, ".", function_name});
+  base::HistogramBase* histogram = base::Histogram::FactoryMicrosecondsTimeGet(
+      name, base::Microseconds(1), base::Seconds(1), 50, kHistogramFlags);
+  task_time_histograms_[function_name] = histogram;
+  return histogram;
+}
+
+}  // namespace net
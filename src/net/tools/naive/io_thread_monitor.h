@@ -0,0 +1,95 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef NET_TOOLS_NAIVE_IO_THREAD_MONITOR_H_
+#define NET_TOOLS_NAIVE_IO_THREAD_MONITOR_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "base/callback.h"
+#include "base/memory/weak_ptr.h"
+#include "base/task/task_observer.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+
+namespace base {
+class HistogramBase;
+}  // namespace base
+
+namespace net {
+
+// Measures how saturated the current IO thread is, so an overloaded thread
+// shows up directly instead of being guessed from CPU graphs:
+//
+// - Naive.IOThread.Lag: how late a periodic probe task runs. This covers
+//   everything the thread does, including IO callbacks from the message pump.
+// - Naive.IOThread.QueueingTime: how long posted tasks wait to run.
+// - Naive.IOThread.TaskTime and Naive.IOThread.TaskTime.<function>: how long
+//   posted tasks run, in total and by the function that posted them.
+// - Naive.IOThread.YieldsPerSecond: how often relay and HTTP/2 read loops
+//   repost themselves after kYieldAfterBytesRead or
+//   kYieldAfterDurationMilliseconds. Relay loops report each repost with
+//   RecordYield(); HTTP/2 sessions count theirs in SpdySessionStats, which
+//   is sampled through SetExternalYieldsCallback().
+//
+// A summary is logged every report interval, at INFO level if the thread
+// looks saturated. The histograms are dumped with the tunnel stats on
+// SIGUSR1.
+class IOThreadMonitor : public base::TaskObserver {
+ public:
+  explicit IOThreadMonitor(const std::string& thread_name);
+  ~IOThreadMonitor() override;
+  IOThreadMonitor(const IOThreadMonitor&) = delete;
+  IOThreadMonitor& operator=(const IOThreadMonitor&) = delete;
+
+  // Starts monitoring the current thread. Must be destroyed on the same
+  // thread.
+  void Start();
+
+  // Counts one repost of a relay loop on the current thread. Does nothing if
+  // the thread has no started monitor.
+  static void RecordYield();
+
+  // Sets a callback returning the total reposts so far of loops that cannot
+  // call RecordYield(). It is sampled at every report.
+  void SetExternalYieldsCallback(base::RepeatingCallback<int64_t()> callback);
+
+  // base::TaskObserver methods.
+  void WillProcessTask(const base::PendingTask& pending_task,
+                       bool was_blocked_or_low_priority) override;
+  void DidProcessTask(const base::PendingTask& pending_task) override;
+
+ private:
+  void PostProbe();
+  void OnProbe(base::TimeTicks expected_time);
+  void Report();
+  base::HistogramBase* GetTaskTimeHistogram(const char* function_name);
+
+  std::string thread_name_;
+  bool started_;
+
+  base::TimeTicks task_start_time_;
+  // Keyed by the function name literal of the posting location.
+  std::map<const char*, base::HistogramBase*> task_time_histograms_;
+
+  // Since the last report.
+  base::TimeTicks report_start_time_;
+  base::TimeDelta max_lag_;
+  base::TimeDelta max_queueing_time_;
+  base::TimeDelta total_task_time_;
+  int64_t num_tasks_;
+  int64_t num_yields_;
+
+  base::RepeatingCallback<int64_t()> external_yields_callback_;
+  // The external yield total at the last report.
+  int64_t last_external_yields_;
+
+  base::RepeatingTimer report_timer_;
+
+  base::WeakPtrFactory<IOThreadMonitor> weak_ptr_factory_{this};
+};
+
+}  // namespace net
+#endif  // NET_TOOLS_NAIVE_IO_THREAD_MONITOR_H_
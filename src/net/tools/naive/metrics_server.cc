@@ -0,0 +1,423 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "net/tools/naive/metrics_server.h"
+
+#include <cstdint>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_split.h"
+#include "base/strings/strcat.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/socket/server_socket.h"
+#include "net/socket/stream_socket.h"
+
+namespace net {
+
+namespace {
+constexpr int kReadBufferSize = 1024;
+constexpr int kMaxRequestSize = 8 * 1024;
+
+void AppendMetric(const std::string& name,
+                  const std::string& type,
+                  const std::string& help,
+                  std::string* out) {
+  base::StrAppend(out, {"# HELP ", name, " ", help, "\n", "# TYPE ", name, " ",
+                        type, "\n"});
+}
+
+void AppendSample(const std::string& name,
+                  const std::string& labels,
+                  const std::string& value,
+                  std::string* out) {
+  base::StrAppend(out, {name, labels.empty() ? "" : "{", labels,
+                        labels.empty() ? "" : "}", " ", value, "\n"});
+}
+
+std::string FormatMetrics(const std::vector<NaiveProxy::Metrics>& metrics) {
+  NaiveProxy::Metrics total;
+  for (const auto& m : metrics) {
+    total.num_connecting += m.num_connecting;
+    total.num_running += m.num_running;
+    total.num_accepted += m.num_accepted;
+    total.num_rejected += m.num_rejected;
+    total.num_accept_pauses += m.num_accept_pauses;
+    total.num_hedged += m.num_hedged;
+    total.num_hedge_wins += m.num_hedge_wins;
+    total.num_standby_promotions += m.num_standby_promotions;
+    total.bytes_relayed += m.bytes_relayed;
+    total.num_spdy_sessions += m.num_spdy_sessions;
+    total.num_quic_sessions += m.num_quic_sessions;
+    total.spdy_session_stats.Add(m.spdy_session_stats);
+    total.num_handed_out_sockets += m.num_handed_out_sockets;
+    total.num_connecting_sockets += m.num_connecting_sockets;
+    total.num_idle_sockets += m.num_idle_sockets;
+  }
+
+  std::string out;
+  AppendMetric("naive_tunnels", "gauge", "Open tunnels by state.", &out);
+  AppendSample("naive_tunnels", "state=\"connecting\"",
+               base::NumberToString(total.num_connecting), &out);
+  AppendSample("naive_tunnels", "state=\"running\"",
+               base::NumberToString(total.num_running), &out);
+
+  AppendMetric("naive_accepted_connections_total", "counter",
+               "Accepted client connections.", &out);
+  AppendSample("naive_accepted_connections_total", "",
+               base::NumberToString(total.num_accepted), &out);
+
+  AppendMetric("naive_rejected_connections_total", "counter",
+               "Client connections rejected by --max-tunnels.", &out);
+  AppendSample("naive_rejected_connections_total", "",
+               base::NumberToString(total.num_rejected), &out);
+
+  AppendMetric("naive_accept_pauses_total", "counter",
+               "Accept pauses caused by --max-connecting.", &out);
+  AppendSample("naive_accept_pauses_total", "",
+               base::NumberToString(total.num_accept_pauses), &out);
+
+  AppendMetric("naive_hedged_tunnels_total", "counter",
+               "Tunnels that raced a second connect after --hedge-delay.",
+               &out);
+  AppendSample("naive_hedged_tunnels_total", "",
+               base::NumberToString(total.num_hedged), &out);
+
+  AppendMetric("naive_hedge_wins_total", "counter",
+               "Hedged tunnels whose second connect finished first.", &out);
+  AppendSample("naive_hedge_wins_total", "",
+               base::NumberToString(total.num_hedge_wins), &out);
+
+  AppendMetric("naive_standby_promotions_total", "counter",
+               "Standby sessions taken over by tunnels.", &out);
+  AppendSample("naive_standby_promotions_total", "",
+               base::NumberToString(total.num_standby_promotions), &out);
+
+  AppendMetric("naive_relayed_bytes_total", "counter",
+               "Bytes relayed in both directions.", &out);
+  AppendSample("naive_relayed_bytes_total", "",
+               base::NumberToString(total.bytes_relayed), &out);
+
+  AppendMetric("naive_upstream_sessions", "gauge",
+               "Multiplexed upstream sessions.", &out);
+  AppendSample("naive_upstream_sessions", "protocol=\"http2\"",
+               base::NumberToString(total.num_spdy_sessions), &out);
+  AppendSample("naive_upstream_sessions", "protocol=\"quic\"",
+               base::NumberToString(total.num_quic_sessions), &out);
+
+  const SpdySessionStats& h2 = total.spdy_session_stats;
+  AppendMetric("naive_http2_closed_streams_total", "counter",
+               "Closed HTTP/2 streams.", &out);
+  AppendSample("naive_http2_closed_streams_total", "",
+               base::NumberToString(h2.num_closed_streams), &out);
+
+  AppendMetric("naive_http2_data_bytes_total", "counter",
+               "DATA payload bytes of closed HTTP/2 streams.", &out);
+  AppendSample("naive_http2_data_bytes_total", "direction=\"sent\"",
+               base::NumberToString(h2.data_bytes_sent), &out);
+  AppendSample("naive_http2_data_bytes_total", "direction=\"received\"",
+               base::NumberToString(h2.data_bytes_received), &out);
+
+  AppendMetric("naive_http2_send_stalls_total", "counter",
+               "HTTP/2 streams stalling on send flow control.", &out);
+  AppendSample("naive_http2_send_stalls_total", "",
+               base::NumberToString(h2.num_send_stalls), &out);
+
+  AppendMetric("naive_http2_send_stalled_seconds_total", "counter",
+               "Time HTTP/2 streams waited on a send window.", &out);
+  AppendSample(
+      "naive_http2_send_stalled_seconds_total", "window=\"stream\"",
+      base::NumberToString(h2.send_stalled_by_stream_time.InSecondsF()), &out);
+  AppendSample(
+      "naive_http2_send_stalled_seconds_total", "window=\"session\"",
+      base::NumberToString(h2.send_stalled_by_session_time.InSecondsF()),
+      &out);
+
+  AppendMetric("naive_http2_session_window_exhausted_seconds_total",
+               "counter", "Time HTTP/2 session send windows were empty.",
+               &out);
+  AppendSample(
+      "naive_http2_session_window_exhausted_seconds_total", "",
+      base::NumberToString(h2.session_send_window_exhausted_time.InSecondsF()),
+      &out);
+
+  AppendMetric("naive_http2_write_queue_depth", "summary",
+               "HTTP/2 write queue depth each time a frame is queued.", &out);
+  AppendSample("naive_http2_write_queue_depth_sum", "",
+               base::NumberToString(h2.write_queue_depth_sum), &out);
+  AppendSample("naive_http2_write_queue_depth_count", "",
+               base::NumberToString(h2.num_write_queue_samples), &out);
+  AppendMetric("naive_http2_write_queue_depth_max", "gauge",
+               "Largest HTTP/2 write queue depth.", &out);
+  AppendSample("naive_http2_write_queue_depth_max", "",
+               base::NumberToString(h2.max_write_queue_depth), &out);
+
+  AppendMetric("naive_http2_ping_rtt_seconds", "summary",
+               "Round trip times of HTTP/2 PINGs.", &out);
+  AppendSample("naive_http2_ping_rtt_seconds_sum", "",
+               base::NumberToString(h2.ping_rtt_sum.InSecondsF()), &out);
+  AppendSample("naive_http2_ping_rtt_seconds_count", "",
+               base::NumberToString(h2.num_ping_rtts), &out);
+  AppendMetric("naive_http2_ping_rtt_seconds_max", "gauge",
+               "Largest HTTP/2 PING round trip time.", &out);
+  AppendSample("naive_http2_ping_rtt_seconds_max", "",
+               base::NumberToString(h2.max_ping_rtt.InSecondsF()), &out);
+
+  AppendMetric("naive_pool_sockets", "gauge",
+               "Upstream sockets in the socket pools by state.", &out);
+  AppendSample("naive_pool_sockets", "state=\"handed_out\"",
+               base::NumberToString(total.num_handed_out_sockets), &out);
+  AppendSample("naive_pool_sockets", "state=\"connecting\"",
+               base::NumberToString(total.num_connecting_sockets), &out);
+  AppendSample("naive_pool_sockets", "state=\"idle\"",
+               base::NumberToString(total.num_idle_sockets), &out);
+
+  AppendMetric("naive_io_thread_cpu_seconds_total", "counter",
+               "CPU time spent by each IO thread.", &out);
+  for (size_t i = 0; i < metrics.size(); i++) {
+    if (metrics[i].thread_cpu_time.is_zero())
+      continue;
+    AppendSample("naive_io_thread_cpu_seconds_total",
+                 base::StrCat({"thread=\"", base::NumberToString(i), "\""}),
+                 base::NumberToString(metrics[i].thread_cpu_time.InSecondsF()),
+                 &out);
+  }
+  return out;
+}
+}  // namespace
+
+struct MetricsServer::Connection {
+  std::unique_ptr<StreamSocket> socket;
+  scoped_refptr<GrowableIOBuffer> read_buffer;
+  scoped_refptr<DrainableIOBuffer> write_buffer;
+  std::vector<NaiveProxy::Metrics> metrics;
+  size_t num_pending_metrics = 0;
+};
+
+MetricsServer::Source::Source(
+    scoped_refptr<base::SingleThreadTaskRunner> task_runner,
+    NaiveProxy* proxy)
+    : task_runner(std::move(task_runner)), proxy(proxy) {}
+
+MetricsServer::Source::Source(const Source&) = default;
+
+MetricsServer::Source::~Source() = default;
+
+MetricsServer::MetricsServer(
+    std::unique_ptr<ServerSocket> listen_socket,
+    std::vector<Source> sources,
+    const NetworkTrafficAnnotationTag& traffic_annotation)
+    : listen_socket_(std::move(listen_socket)),
+      sources_(std::move(sources)),
+      last_id_(0),
+      traffic_annotation_(traffic_annotation) {
+  DCHECK(listen_socket_);
+  base::ThreadTaskRunnerHandle::Get()->PostTask(
+      FROM_HERE, base::BindOnce(&MetricsServer::DoAcceptLoop,
+                                weak_ptr_factory_.GetWeakPtr()));
+}
+
+MetricsServer::~MetricsServer() = default;
+
+void MetricsServer::DoAcceptLoop() {
+  int result;
+  do {
+    result = listen_socket_->Accept(
+        &accepted_socket_,
+        base::BindRepeating(&MetricsServer::OnAcceptComplete,
+                            weak_ptr_factory_.GetWeakPtr()));
+    if (result == ERR_IO_PENDING)
+      return;
+    HandleAcceptResult(result);
+  } while (result == OK);
+}
+
+void MetricsServer::OnAcceptComplete(int result) {
+  HandleAcceptResult(result);
+  if (result == OK)
+    DoAcceptLoop();
+}
+
+void MetricsServer::HandleAcceptResult(int result) {
+  if (result != OK) {
+    LOG(ERROR) << "Metrics accept error: rv=" << result;
+    return;
+  }
+  unsigned int connection_id = ++last_id_;
+  auto connection = std::make_unique<Connection>();
+  connection->socket = std::move(accepted_socket_);
+  connection->read_buffer = base::MakeRefCounted<GrowableIOBuffer>();
+  connections_[connection_id] = std::move(connection);
+  DoReadLoop(connection_id);
+}
+
+void MetricsServer::DoReadLoop(unsigned int connection_id) {
+  int result;
+  do {
+    Connection* connection = FindConnection(connection_id);
+    if (!connection)
+      return;
+    GrowableIOBuffer* buffer = connection->read_buffer.get();
+    if (buffer->RemainingCapacity() < kReadBufferSize)
+      buffer->SetCapacity(buffer->offset() + kReadBufferSize);
+    result = connection->socket->Read(
+        buffer, buffer->RemainingCapacity(),
+        base::BindOnce(&MetricsServer::OnReadComplete,
+                       weak_ptr_factory_.GetWeakPtr(), connection_id));
+    if (result == ERR_IO_PENDING)
+      return;
+  } while (HandleReadResult(connection_id, result));
+}
+
+void MetricsServer::OnReadComplete(unsigned int connection_id, int result) {
+  if (HandleReadResult(connection_id, result))
+    DoReadLoop(connection_id);
+}
+
+bool MetricsServer::HandleReadResult(unsigned int connection_id, int result) {
+  Connection* connection = FindConnection(connection_id);
+  if (!connection)
+    return false;
+  if (result <= 0) {
+    Close(connection_id);
+    return false;
+  }
+  GrowableIOBuffer* buffer = connection->read_buffer.get();
+  buffer->set_offset(buffer->offset() + result);
+  base::StringPiece request(buffer->StartOfBuffer(), buffer->offset());
+  if (request.find("\r\n\r\n") == base::StringPiece::npos) {
+    if (buffer->offset() >= kMaxRequestSize) {
+      Close(connection_id);
+      return false;
+    }
+    return true;
+  }
+  HandleRequest(connection_id);
+  return false;
+}
+
+void MetricsServer::HandleRequest(unsigned int connection_id) {
+  Connection* connection = FindConnection(connection_id);
+  GrowableIOBuffer* buffer = connection->read_buffer.get();
+  base::StringPiece request(buffer->StartOfBuffer(), buffer->offset());
+  base::StringPiece request_line = request.substr(0, request.find("\r\n"));
+  std::vector<base::StringPiece> parts = base::SplitStringPiece(
+      request_line, " ", base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+  if (parts.size() != 3 || parts[0] != "GET") {
+    SendResponse(connection_id, "405 Method Not Allowed", "");
+    return;
+  }
+  if (parts[1] != "/metrics") {
+    SendResponse(connection_id, "404 Not Found", "");
+    return;
+  }
+
+  connection->metrics.resize(sources_.size());
+  connection->num_pending_metrics = sources_.size();
+  for (size_t i = 0; i < sources_.size(); i++) {
+    // Proxies are deleted on their own threads after this server is gone,
+    // behind any task posted here, so the raw pointer stays valid.
+    sources_[i].task_runner->PostTaskAndReplyWithResult(
+        FROM_HERE,
+        base::BindOnce(&NaiveProxy::GetMetrics,
+                       base::Unretained(sources_[i].proxy)),
+        base::BindOnce(&MetricsServer::OnMetrics,
+                       weak_ptr_factory_.GetWeakPtr(), connection_id, i));
+  }
+}
+
+void MetricsServer::OnMetrics(unsigned int connection_id,
+                              size_t source_index,
+                              NaiveProxy::Metrics metrics) {
+  Connection* connection = FindConnection(connection_id);
+  if (!connection)
+    return;
+  connection->metrics[source_index] = metrics;
+  if (--connection->num_pending_metrics > 0)
+    return;
+  SendResponse(connection_id, "200 OK", FormatMetrics(connection->metrics));
+}
+
+void MetricsServer::SendResponse(unsigned int connection_id,
+                                 const std::string& status,
+                                 const std::string& body) {
+  Connection* connection = FindConnection(connection_id);
+  std::string response = base::StrCat(
+      {"HTTP/1.1 ", status,
+       "\r\n"
+       "Content-Type: text/plain; version=0.0.4\r\n"
+       "Content-Length: ",
+       base::NumberToString(body.size()),
+       "\r\n"
+       "Connection: close\r\n"
+       "\r\n",
+       body});
+  connection->write_buffer = base::MakeRefCounted<DrainableIOBuffer>(
+      base::MakeRefCounted<StringIOBuffer>(response), response.size());
+  DoWriteLoop(connection_id);
+}
+
+void MetricsServer::DoWriteLoop(unsigned int connection_id) {
+  int result;
+  do {
+    Connection* connection = FindConnection(connection_id);
+    if (!connection)
+      return;
+    DrainableIOBuffer* buffer = connection->write_buffer.get();
+    result = connection->socket->Write(
+        buffer, buffer->BytesRemaining(),
+        base::BindOnce(&MetricsServer::OnWriteComplete,
+                       weak_ptr_factory_.GetWeakPtr(), connection_id),
+        traffic_annotation_);
+    if (result == ERR_IO_PENDING)
+      return;
+  } while (HandleWriteResult(connection_id, result));
+}
+
+void MetricsServer::OnWriteComplete(unsigned int connection_id, int result) {
+  if (HandleWriteResult(connection_id, result))
+    DoWriteLoop(connection_id);
+}
+
+bool MetricsServer::HandleWriteResult(unsigned int connection_id, int result) {
+  Connection* connection = FindConnection(connection_id);
+  if (!connection)
+    return false;
+  if (result < 0) {
+    Close(connection_id);
+    return false;
+  }
+  DrainableIOBuffer* buffer = connection->write_buffer.get();
+  buffer->DidConsume(result);
+  if (buffer->BytesRemaining() > 0)
+    return true;
+  Close(connection_id);
+  return false;
+}
+
+MetricsServer::Connection* MetricsServer::FindConnection(
+    unsigned int connection_id) {
+  auto it = connections_.find(connection_id);
+  if (it == connections_.end())
+    return nullptr;
+  return it->second.get();
+}
+
+void MetricsServer::Close(unsigned int connection_id) {
+  auto it = connections_.find(connection_id);
+  if (it == connections_.end())
+    return;
+  // The socket may still be in the call stack, so it is destroyed in the
+  // next run loop like in NaiveProxy::Close().
+  base::ThreadTaskRunnerHandle::Get()->DeleteSoon(FROM_HERE,
+                                                  std::move(it->second));
+  connections_.erase(it);
+}
+
+}  // namespace net
@@ -0,0 +1,91 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef NET_TOOLS_NAIVE_METRICS_SERVER_H_
+#define NET_TOOLS_NAIVE_METRICS_SERVER_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_refptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/task/single_thread_task_runner.h"
+#include "net/tools/naive/naive_proxy.h"
+
+namespace net {
+
+class DrainableIOBuffer;
+class GrowableIOBuffer;
+class ServerSocket;
+class StreamSocket;
+struct NetworkTrafficAnnotationTag;
+
+// Serves a read-only page of proxy counters in the Prometheus text format at
+// /metrics. There is no authentication, so it should only listen on
+// loopback. Each request gathers a snapshot from every proxy on its own
+// thread.
+class MetricsServer {
+ public:
+  // A proxy and the thread it runs on.
+  struct Source {
+    Source(scoped_refptr<base::SingleThreadTaskRunner> task_runner,
+           NaiveProxy* proxy);
+    Source(const Source&);
+    ~Source();
+
+    scoped_refptr<base::SingleThreadTaskRunner> task_runner;
+    NaiveProxy* proxy;
+  };
+
+  // The proxies must outlive this server.
+  MetricsServer(std::unique_ptr<ServerSocket> listen_socket,
+                std::vector<Source> sources,
+                const NetworkTrafficAnnotationTag& traffic_annotation);
+  ~MetricsServer();
+  MetricsServer(const MetricsServer&) = delete;
+  MetricsServer& operator=(const MetricsServer&) = delete;
+
+ private:
+  struct Connection;
+
+  void DoAcceptLoop();
+  void OnAcceptComplete(int result);
+  void HandleAcceptResult(int result);
+
+  void DoReadLoop(unsigned int connection_id);
+  void OnReadComplete(unsigned int connection_id, int result);
+  // Returns false if the connection is closed.
+  bool HandleReadResult(unsigned int connection_id, int result);
+  void HandleRequest(unsigned int connection_id);
+
+  void OnMetrics(unsigned int connection_id,
+                 size_t source_index,
+                 NaiveProxy::Metrics metrics);
+
+  void SendResponse(unsigned int connection_id,
+                    const std::string& status,
+                    const std::string& body);
+  void DoWriteLoop(unsigned int connection_id);
+  void OnWriteComplete(unsigned int connection_id, int result);
+  // Returns false if the connection is closed.
+  bool HandleWriteResult(unsigned int connection_id, int result);
+
+  Connection* FindConnection(unsigned int connection_id);
+  void Close(unsigned int connection_id);
+
+  std::unique_ptr<ServerSocket> listen_socket_;
+  std::vector<Source> sources_;
+  std::unique_ptr<StreamSocket> accepted_socket_;
+
+  unsigned int last_id_;
+  std::map<unsigned int, std::unique_ptr<Connection>> connections_;
+
+  const NetworkTrafficAnnotationTag& traffic_annotation_;
+
+  base::WeakPtrFactory<MetricsServer> weak_ptr_factory_{this};
+};
+
+}  // namespace net
+#endif  // NET_TOOLS_NAIVE_METRICS_SERVER_H_
@@ -5,6 +5,7 @@
 
 #include "net/tools/naive/naive_connection.h"
 
+#include <algorithm>
 #include <cstring>
 #include <utility>
 
@@ -15,17 +16,24 @@
 #include "base/strings/strcat.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "base/time/time.h"
+#include "base/values.h"
 #include "net/base/io_buffer.h"
 #include "net/base/load_flags.h"
 #include "net/base/net_errors.h"
 #include "net/base/privacy_mode.h"
+#include "net/base/proxy_server.h"
+#include "net/log/net_log_event_type.h"
+#include "net/log/net_log_values.h"
+#include "net/log/net_log_with_source.h"
 #include "net/proxy_resolution/proxy_info.h"
 #include "net/socket/client_socket_handle.h"
 #include "net/socket/client_socket_pool_manager.h"
 #include "net/socket/stream_socket.h"
 #include "net/spdy/spdy_session.h"
 #include "net/tools/naive/http_proxy_socket.h"
+#include "net/tools/naive/io_thread_monitor.h"
 #include "net/tools/naive/redirect_resolver.h"
+#include "net/tools/naive/relay_buffer_pool.h"
 #include "net/tools/naive/socks5_server_socket.h"
 
 #if defined(OS_LINUX)
@@ -36,19 +44,47 @@
 #include "net/base/ip_endpoint.h"
 #include "net/base/sockaddr_storage.h"
 #include "net/socket/tcp_client_socket.h"
+#include "net/tools/naive/splice_relay.h"
 #endif
 
 namespace net {
 
 namespace {
-constexpr int kBufferSize = 64 * 1024;
 constexpr int kFirstPaddings = 8;
 constexpr int kPaddingHeaderSize = 3;
 constexpr int kMaxPaddingSize = 255;
+// The padding header can only describe payloads up to 65535 bytes.
+constexpr int kMaxPaddedBufferSize = 64 * 1024;
+
+// Relay reads start small and adapt to how full they come back, so idle and
+// interactive tunnels hold little memory while bulk ones batch more per read.
+constexpr int kInitialReadSize = RelayBufferPool::kMinBufferSize;
+
+const char* DirectionToString(Direction side) {
+  return side == kClient ? "client" : "server";
+}
+
+const char* ProxyInfoToTunnelType(const ProxyInfo& proxy_info) {
+  if (proxy_info.is_direct())
+    return "direct";
+  switch (proxy_info.proxy_server().scheme()) {
+    case ProxyServer::SCHEME_HTTP:
+      return "http";
+    case ProxyServer::SCHEME_HTTPS:
+      return "https";
+    case ProxyServer::SCHEME_QUIC:
+      return "quic";
+    case ProxyServer::SCHEME_SOCKS4:
+    case ProxyServer::SCHEME_SOCKS5:
+      return "socks";
+    default:
+      return "unknown";
+  }
+}
 }  // namespace
 
 NaiveConnection::NaiveConnection(
-    unsigned int id,
+    uint64_t id,
     ClientProtocol protocol,
     std::unique_ptr<PaddingDetectorDelegate> padding_detector_delegate,
     const ProxyInfo& proxy_info,
@@ -56,7 +92,10 @@ NaiveConnection::NaiveConnection(
     const SSLConfig& proxy_ssl_config,
     RedirectResolver* resolver,
     HttpNetworkSession* session,
+    RelayBufferPool* buffer_pool,
     const NetworkIsolationKey& network_isolation_key,
+    const NetworkIsolationKey& hedge_network_isolation_key,
+    base::TimeDelta hedge_delay,
     const NetLogWithSource& net_log,
     std::unique_ptr<StreamSocket> accepted_socket,
     const NetworkTrafficAnnotationTag& traffic_annotation)
@@ -68,20 +107,29 @@ NaiveConnection::NaiveConnection(
       proxy_ssl_config_(proxy_ssl_config),
       resolver_(resolver),
       session_(session),
+      buffer_pool_(buffer_pool),
       network_isolation_key_(network_isolation_key),
+      hedge_network_isolation_key_(hedge_network_isolation_key),
       net_log_(net_log),
       next_state_(STATE_NONE),
       client_socket_(std::move(accepted_socket)),
       server_socket_handle_(std::make_unique<ClientSocketHandle>()),
+      hedge_delay_(hedge_delay),
+      hedged_(false),
+      hedge_won_(false),
       sockets_{client_socket_.get(), nullptr},
       errors_{OK, OK},
       write_pending_{false, false},
       early_pull_pending_(false),
       can_push_to_server_(false),
       early_pull_result_(ERR_IO_PENDING),
+      read_sizes_{kInitialReadSize, kInitialReadSize},
+      last_read_sizes_{0, 0},
       num_paddings_{0, 0},
       read_padding_state_(STATE_READ_PAYLOAD_LENGTH_1),
       full_duplex_(false),
+      num_yields_(0),
+      bytes_copied_{0, 0},
       time_func_(&base::TimeTicks::Now),
       traffic_annotation_(traffic_annotation) {
   io_callback_ = base::BindRepeating(&NaiveConnection::OnIOComplete,
@@ -100,6 +148,7 @@ int NaiveConnection::Connect(CompletionOnceCallback callback) {
   if (full_duplex_)
     return OK;
 
+  connect_start_time_ = time_func_();
   next_state_ = STATE_CONNECT_CLIENT;
 
   int rv = DoLoop(OK);
@@ -111,6 +160,12 @@ int NaiveConnection::Connect(CompletionOnceCallback callback) {
 
 void NaiveConnection::Disconnect() {
   full_duplex_ = false;
+#if defined(OS_LINUX)
+  // Stops watching the descriptors before the sockets close them.
+  splice_relay_.reset();
+#endif
+  hedge_timer_.Stop();
+  hedge_socket_handle_.reset();
   // Closes server side first because latency is higher.
   if (server_socket_handle_->socket())
     server_socket_handle_->socket()->Disconnect();
@@ -178,11 +233,15 @@ int NaiveConnection::DoConnectClientComplete(int result) {
   if (result < 0)
     return result;
 
+  client_connected_time_ = time_func_();
+
   // For proxy client sockets, padding support detection is finished after the
   // first server response which means there will be one missed early pull. For
   // proxy server sockets (HttpProxySocket), padding support detection is
   // done during client connect, so there shouldn't be any missed early pull.
-  if (!padding_detector_delegate_->IsPaddingSupportKnown()) {
+  // Spliced connections skip the early pull too, because the client socket
+  // must not have a pending read when the splice relay takes over.
+  if (!padding_detector_delegate_->IsPaddingSupportKnown() || CanSplice()) {
     early_pull_pending_ = false;
     early_pull_result_ = 0;
     next_state_ = STATE_CONNECT_SERVER;
@@ -249,27 +308,85 @@ int NaiveConnection::DoConnectServer() {
   }
 
   LOG(INFO) << "Connection " << id_ << " to " << origin.ToString();
-
-  // Ignores socket limit set by socket pool for this type of socket.
-  return InitSocketHandleForRawConnect2(
-      origin, session_, LOAD_IGNORE_LIMITS, MAXIMUM_PRIORITY, proxy_info_,
-      server_ssl_config_, proxy_ssl_config_, PRIVACY_MODE_DISABLED,
-      network_isolation_key_, net_log_, server_socket_handle_.get(),
-      io_callback_);
+  origin_ = origin;
+  server_connect_start_time_ = time_func_();
+
+  int rv = ConnectServer(network_isolation_key_, server_socket_handle_.get(),
+                         io_callback_);
+  if (rv == ERR_IO_PENDING && !hedge_delay_.is_zero()) {
+    hedge_timer_.Start(FROM_HERE, hedge_delay_,
+                       base::BindOnce(&NaiveConnection::StartHedge,
+                                      base::Unretained(this)));
+  }
+  return rv;
 }
 
 int NaiveConnection::DoConnectServerComplete(int result) {
+  hedge_timer_.Stop();
+  if (result < 0 && hedge_socket_handle_) {
+    // The hedged attempt is still pending and takes over.
+    server_socket_handle_ = std::move(hedge_socket_handle_);
+    next_state_ = STATE_CONNECT_SERVER_COMPLETE;
+    return ERR_IO_PENDING;
+  }
+  // Cancels the hedged attempt if the first one won.
+  hedge_socket_handle_.reset();
   if (result < 0)
     return result;
 
   DCHECK(server_socket_handle_->socket());
   sockets_[kServer] = server_socket_handle_->socket();
+  server_connected_time_ = time_func_();
 
   full_duplex_ = true;
   next_state_ = STATE_NONE;
   return OK;
 }
 
+int NaiveConnection::ConnectServer(
+    const NetworkIsolationKey& network_isolation_key,
+    ClientSocketHandle* socket_handle,
+    CompletionOnceCallback callback) {
+  // Ignores socket limit set by socket pool for this type of socket.
+  return InitSocketHandleForRawConnect2(
+      origin_, session_, LOAD_IGNORE_LIMITS, MAXIMUM_PRIORITY, proxy_info_,
+      server_ssl_config_, proxy_ssl_config_, PRIVACY_MODE_DISABLED,
+      network_isolation_key, net_log_, socket_handle, std::move(callback));
+}
+
+void NaiveConnection::StartHedge() {
+  DCHECK_EQ(next_state_, STATE_CONNECT_SERVER_COMPLETE);
+  DCHECK(!hedge_socket_handle_);
+
+  VLOG(1) << "Connection " << id_ << " hedged after "
+          << hedge_delay_.InMilliseconds() << " ms";
+  hedged_ = true;
+  hedge_socket_handle_ = std::make_unique<ClientSocketHandle>();
+  int rv = ConnectServer(hedge_network_isolation_key_,
+                         hedge_socket_handle_.get(),
+                         base::BindOnce(&NaiveConnection::OnHedgeComplete,
+                                        weak_ptr_factory_.GetWeakPtr()));
+  if (rv != ERR_IO_PENDING)
+    OnHedgeComplete(rv);
+}
+
+void NaiveConnection::OnHedgeComplete(int result) {
+  if (!hedge_socket_handle_) {
+    // The first attempt failed and this one took its place.
+    OnIOComplete(result);
+    return;
+  }
+  if (result < 0) {
+    // Keeps waiting for the first attempt.
+    hedge_socket_handle_.reset();
+    return;
+  }
+  hedge_won_ = true;
+  // Cancels the first attempt.
+  server_socket_handle_ = std::move(hedge_socket_handle_);
+  OnIOComplete(result);
+}
+
 int NaiveConnection::Run(CompletionOnceCallback callback) {
   DCHECK(sockets_[kClient]);
   DCHECK(sockets_[kServer]);
@@ -291,6 +408,9 @@ int NaiveConnection::Run(CompletionOnceCallback callback) {
   yield_after_time_[kServer] = yield_after_time_[kClient];
 
   can_push_to_server_ = true;
+  if (CanSplice() && StartSplice())
+    return ERR_IO_PENDING;
+
   // early_pull_result_ == 0 means the early pull was not started because
   // padding support was not yet known.
   if (!early_pull_pending_ && early_pull_result_ == 0) {
@@ -307,22 +427,51 @@ int NaiveConnection::Run(CompletionOnceCallback callback) {
 void NaiveConnection::Pull(Direction from, Direction to) {
   if (errors_[kClient] < 0 || errors_[kServer] < 0)
     return;
+  DCHECK(sockets_[from]);
 
-  int read_size = kBufferSize;
+  int buffer_size = read_sizes_[from];
+  int read_size = buffer_size;
   auto padding_direction = padding_detector_delegate_->GetPaddingDirection();
-  if (from == padding_direction && num_paddings_[from] < kFirstPaddings) {
-    auto buffer = base::MakeRefCounted<GrowableIOBuffer>();
-    buffer->SetCapacity(kBufferSize);
-    buffer->set_offset(kPaddingHeaderSize);
-    read_buffers_[from] = buffer;
-    read_size = kBufferSize - kPaddingHeaderSize - kMaxPaddingSize;
-  } else {
-    read_buffers_[from] = base::MakeRefCounted<IOBuffer>(kBufferSize);
+  bool add_padding =
+      from == padding_direction && num_paddings_[from] < kFirstPaddings;
+  bool remove_padding =
+      to == padding_direction && num_paddings_[from] < kFirstPaddings;
+  if (!add_padding && !remove_padding &&
+      !(from == kClient && early_pull_pending_)) {
+    // Takes the data as it is held by the socket, e.g. slices of the HTTP/2
+    // session's read buffer, instead of copying it into a relay buffer.
+    // Padding needs a relay buffer to edit in place.
+    scoped_refptr<IOBuffer> buffer;
+    int rv = sockets_[from]->ReadBufferIfReady(
+        &buffer, read_size,
+        base::BindOnce(&NaiveConnection::OnPullReady,
+                       weak_ptr_factory_.GetWeakPtr(), from, to));
+    if (rv != ERR_READ_IF_READY_NOT_IMPLEMENTED) {
+      if (rv == ERR_IO_PENDING)
+        return;
+      read_buffers_[from] = std::move(buffer);
+      last_read_sizes_[from] = read_size;
+      OnPullComplete(from, to, rv);
+      return;
+    }
+  }
+  if (add_padding) {
+    buffer_size = std::min(buffer_size, kMaxPaddedBufferSize);
+    read_size = buffer_size - kPaddingHeaderSize - kMaxPaddingSize;
+  }
+  read_buffers_[from] = buffer_pool_->Get(buffer_size);
+  scoped_refptr<IOBuffer> read_buffer = read_buffers_[from];
+  if (add_padding) {
+    // Leaves room for the padding header in front of the payload.
+    auto buffer =
+        base::MakeRefCounted<DrainableIOBuffer>(read_buffer, buffer_size);
+    buffer->DidConsume(kPaddingHeaderSize);
+    read_buffer = std::move(buffer);
   }
+  last_read_sizes_[from] = read_size;
 
-  DCHECK(sockets_[from]);
   int rv = sockets_[from]->Read(
-      read_buffers_[from].get(), read_size,
+      read_buffer.get(), read_size,
       base::BindRepeating(&NaiveConnection::OnPullComplete,
                           weak_ptr_factory_.GetWeakPtr(), from, to));
 
@@ -341,9 +490,7 @@ void NaiveConnection::Push(Direction from, Direction to, int size) {
     // Adds padding.
     ++num_paddings_[from];
     int padding_size = base::RandInt(0, kMaxPaddingSize);
-    auto* buffer = static_cast<GrowableIOBuffer*>(read_buffers_[from].get());
-    buffer->set_offset(0);
-    uint8_t* p = reinterpret_cast<uint8_t*>(buffer->data());
+    uint8_t* p = reinterpret_cast<uint8_t*>(read_buffers_[from]->data());
     p[0] = size / 256;
     p[1] = size % 256;
     p[2] = padding_size;
@@ -351,7 +498,7 @@ void NaiveConnection::Push(Direction from, Direction to, int size) {
     write_size = kPaddingHeaderSize + size + padding_size;
   } else if (to == padding_direction && num_paddings_[from] < kFirstPaddings) {
     // Removes padding.
-    const char* p = read_buffers_[from]->data();
+    char* p = read_buffers_[from]->data();
     bool trivial_padding = false;
     if (read_padding_state_ == STATE_READ_PAYLOAD_LENGTH_1 &&
         size >= kPaddingHeaderSize) {
@@ -366,13 +513,26 @@ void NaiveConnection::Push(Direction from, Direction to, int size) {
       }
     }
     if (!trivial_padding) {
-      auto unpadded_buffer = base::MakeRefCounted<IOBuffer>(kBufferSize);
-      char* unpadded_ptr = unpadded_buffer->data();
+      // Compacts the payload in place. The unpadded output never runs ahead
+      // of the input, so the first payload slice is left where it is and
+      // later slices are moved down to follow it.
+      int unpadded_offset = -1;
+      int unpadded_size = 0;
+      auto append_payload = [&](int offset, int length) {
+        if (length == 0)
+          return;
+        if (unpadded_offset < 0) {
+          unpadded_offset = offset;
+        } else if (unpadded_offset + unpadded_size != offset) {
+          std::memmove(p + unpadded_offset + unpadded_size, p + offset,
+                       length);
+        }
+        unpadded_size += length;
+      };
       for (int i = 0; i < size;) {
         if (num_paddings_[from] >= kFirstPaddings &&
             read_padding_state_ == STATE_READ_PAYLOAD_LENGTH_1) {
-          std::memcpy(unpadded_ptr, p + i, size - i);
-          unpadded_ptr += size - i;
+          append_payload(i, size - i);
           break;
         }
         int copy_size;
@@ -400,8 +560,7 @@ void NaiveConnection::Push(Direction from, Direction to, int size) {
             } else {
               copy_size = size - i;
             }
-            std::memcpy(unpadded_ptr, p + i, copy_size);
-            unpadded_ptr += copy_size;
+            append_payload(i, copy_size);
             i += copy_size;
             payload_length_ -= copy_size;
             break;
@@ -418,8 +577,8 @@ void NaiveConnection::Push(Direction from, Direction to, int size) {
             break;
         }
       }
-      write_size = unpadded_ptr - unpadded_buffer->data();
-      read_buffers_[from] = unpadded_buffer;
+      write_offset = unpadded_offset < 0 ? 0 : unpadded_offset;
+      write_size = unpadded_size;
     }
     if (write_size == 0) {
       OnPushComplete(from, to, OK);
@@ -496,6 +655,14 @@ void NaiveConnection::OnPushError(Direction from, Direction to, int error) {
     OnBothDisconnected();
 }
 
+void NaiveConnection::OnPullReady(Direction from, Direction to, int result) {
+  if (result < 0) {
+    OnPullComplete(from, to, result);
+    return;
+  }
+  Pull(from, to);
+}
+
 void NaiveConnection::OnPullComplete(Direction from, Direction to, int result) {
   if (from == kClient && early_pull_pending_) {
     early_pull_pending_ = false;
@@ -506,6 +673,10 @@ void NaiveConnection::OnPullComplete(Direction from, Direction to, int result) {
     OnPullError(from, to, result ? result : ERR_CONNECTION_CLOSED);
     return;
   }
+  if (from == kServer && first_byte_time_.is_null())
+    first_byte_time_ = time_func_();
+  bytes_copied_[from] += result;
+  UpdateReadSize(from, result);
 
   if (from == kClient && !can_push_to_server_)
     return;
@@ -531,6 +702,8 @@ void NaiveConnection::OnPushComplete(Direction from, Direction to, int result) {
   }
 
   write_pending_[to] = false;
+  // Returns the buffer to the pool before the next pull takes one.
+  write_buffers_[to] = nullptr;
   // Checks for termination even if result is OK.
   OnPushError(from, to, result >= 0 ? OK : result);
 
@@ -539,6 +712,8 @@ void NaiveConnection::OnPushComplete(Direction from, Direction to, int result) {
     bytes_passed_without_yielding_[from] = 0;
     yield_after_time_[from] =
         time_func_() + base::Milliseconds(kYieldAfterDurationMilliseconds);
+    ++num_yields_;
+    IOThreadMonitor::RecordYield();
     base::ThreadTaskRunnerHandle::Get()->PostTask(
         FROM_HERE,
         base::BindRepeating(&NaiveConnection::Pull,
@@ -548,4 +723,119 @@ void NaiveConnection::OnPushComplete(Direction from, Direction to, int result) {
   }
 }
 
+void NaiveConnection::UpdateReadSize(Direction from, int result) {
+  int read_size = read_sizes_[from];
+  if (result >= last_read_sizes_[from]) {
+    // The socket had more to give than was asked for.
+    read_size = std::min(read_size * 2, buffer_pool_->max_buffer_size());
+  } else if (result <= read_size / 4) {
+    read_size = std::max(read_size / 2, kInitialReadSize);
+  }
+  if (read_size == read_sizes_[from])
+    return;
+
+  read_sizes_[from] = read_size;
+  net_log_.AddEvent(NetLogEventType::NAIVE_CONNECTION_READ_SIZE_CHANGED, [&] {
+    base::Value dict(base::Value::Type::DICTIONARY);
+    dict.SetKey("connection_id", NetLogNumberValue(id_));
+    dict.SetStringKey("direction", DirectionToString(from));
+    dict.SetIntKey("read_size", read_size);
+    return dict;
+  });
+}
+
+int64_t NaiveConnection::bytes_spliced() const {
+#if defined(OS_LINUX)
+  if (splice_relay_) {
+    return splice_relay_->bytes_relayed(kClient) +
+           splice_relay_->bytes_relayed(kServer);
+  }
+#endif
+  return 0;
+}
+
+void NaiveConnection::GetStats(TunnelStats::Record* record) const {
+  if (!origin_.IsEmpty())
+    record->origin = origin_.ToString();
+  record->tunnel_type = ProxyInfoToTunnelType(proxy_info_);
+  record->duration = time_func_() - connect_start_time_;
+  if (!client_connected_time_.is_null()) {
+    record->client_connected = true;
+    record->client_connect_time = client_connected_time_ - connect_start_time_;
+  }
+  if (!server_connected_time_.is_null()) {
+    record->server_connected = true;
+    record->server_connect_time =
+        server_connected_time_ - server_connect_start_time_;
+  }
+  base::TimeTicks first_byte_time = first_byte_time_;
+  record->bytes[kClient] = bytes_copied_[kClient];
+  record->bytes[kServer] = bytes_copied_[kServer];
+  record->num_yields = num_yields_;
+#if defined(OS_LINUX)
+  if (splice_relay_) {
+    first_byte_time = splice_relay_->first_read_time(kServer);
+    record->bytes[kClient] += splice_relay_->bytes_relayed(kClient);
+    record->bytes[kServer] += splice_relay_->bytes_relayed(kServer);
+    record->num_yields += splice_relay_->num_yields();
+  }
+#endif
+  if (!first_byte_time.is_null() && record->server_connected) {
+    record->has_first_byte = true;
+    record->first_byte_time = first_byte_time - server_connected_time_;
+  }
+}
+
+// Splicing needs a plain TCP descriptor on both sides with nothing buffered
+// in userspace, i.e. a direct connection from a redir or SOCKS listener.
+// TLS, H2 and QUIC upstreams always take the copy path.
+bool NaiveConnection::CanSplice() const {
+#if defined(OS_LINUX)
+  if (!proxy_info_.is_direct())
+    return false;
+  return protocol_ == ClientProtocol::kRedir ||
+         protocol_ == ClientProtocol::kSocks5;
+#else
+  return false;
+#endif
+}
+
+bool NaiveConnection::StartSplice() {
+#if defined(OS_LINUX)
+  DCHECK_EQ(padding_detector_delegate_->GetPaddingDirection(), kNone);
+  const StreamSocket* client_transport = client_socket_.get();
+  if (protocol_ == ClientProtocol::kSocks5) {
+    client_transport =
+        static_cast<const Socks5ServerSocket*>(client_socket_.get())
+            ->transport_socket();
+  }
+  int client_fd = static_cast<const TCPClientSocket*>(client_transport)
+                      ->SocketDescriptorForTesting();
+  int server_fd = static_cast<const TCPClientSocket*>(sockets_[kServer])
+                      ->SocketDescriptorForTesting();
+
+  auto splice_relay = std::make_unique<SpliceRelay>(client_fd, server_fd);
+  int rv = splice_relay->Init();
+  if (rv != OK) {
+    LOG(WARNING) << "Connection " << id_
+                 << " falls back to copying: " << ErrorToShortString(rv);
+    return false;
+  }
+  splice_relay_ = std::move(splice_relay);
+  splice_relay_->Run(base::BindOnce(&NaiveConnection::OnSpliceComplete,
+                                    weak_ptr_factory_.GetWeakPtr()));
+  return true;
+#else
+  return false;
+#endif
+}
+
+void NaiveConnection::OnSpliceComplete(int result) {
+  DCHECK_LT(result, 0);
+  errors_[splice_relay_->error_side()] = result;
+  Disconnect(kServer);
+  Disconnect(kClient);
+  OnBothDisconnected();
+}
+
 }  // namespace net
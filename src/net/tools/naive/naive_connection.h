@@ -6,16 +6,22 @@
 #ifndef NET_TOOLS_NAIVE_NAIVE_CONNECTION_H_
 #define NET_TOOLS_NAIVE_NAIVE_CONNECTION_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
 #include "base/memory/scoped_refptr.h"
 #include "base/memory/weak_ptr.h"
 #include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "build/build_config.h"
 #include "net/base/completion_once_callback.h"
 #include "net/base/completion_repeating_callback.h"
+#include "net/base/host_port_pair.h"
+#include "net/base/network_isolation_key.h"
 #include "net/tools/naive/naive_protocol.h"
 #include "net/tools/naive/naive_proxy_delegate.h"
+#include "net/tools/naive/tunnel_stats.h"
 
 namespace net {
 
@@ -29,14 +35,15 @@ class StreamSocket;
 struct NetworkTrafficAnnotationTag;
 struct SSLConfig;
 class RedirectResolver;
-class NetworkIsolationKey;
+class RelayBufferPool;
+class SpliceRelay;
 
 class NaiveConnection {
  public:
   using TimeFunc = base::TimeTicks (*)();
 
   NaiveConnection(
-      unsigned int id,
+      uint64_t id,
       ClientProtocol protocol,
       std::unique_ptr<PaddingDetectorDelegate> padding_detector_delegate,
       const ProxyInfo& proxy_info,
@@ -44,7 +51,10 @@ class NaiveConnection {
       const SSLConfig& proxy_ssl_config,
       RedirectResolver* resolver,
       HttpNetworkSession* session,
+      RelayBufferPool* buffer_pool,
       const NetworkIsolationKey& network_isolation_key,
+      const NetworkIsolationKey& hedge_network_isolation_key,
+      base::TimeDelta hedge_delay,
       const NetLogWithSource& net_log,
       std::unique_ptr<StreamSocket> accepted_socket,
       const NetworkTrafficAnnotationTag& traffic_annotation);
@@ -52,7 +62,19 @@ class NaiveConnection {
   NaiveConnection(const NaiveConnection&) = delete;
   NaiveConnection& operator=(const NaiveConnection&) = delete;
 
-  unsigned int id() const { return id_; }
+  uint64_t id() const { return id_; }
+  // Bytes relayed through userspace buffers.
+  int64_t bytes_copied() const {
+    return bytes_copied_[kClient] + bytes_copied_[kServer];
+  }
+  // Bytes relayed with splice() without entering userspace.
+  int64_t bytes_spliced() const;
+  // Whether a second connect attempt was raced against the first, and
+  // whether it won.
+  bool hedged() const { return hedged_; }
+  bool hedge_won() const { return hedge_won_; }
+  // Fills in the measurements of this tunnel so far, except the result.
+  void GetStats(TunnelStats::Record* record) const;
   int Connect(CompletionOnceCallback callback);
   void Disconnect();
   int Run(CompletionOnceCallback callback);
@@ -81,6 +103,11 @@ class NaiveConnection {
   int DoConnectClientComplete(int result);
   int DoConnectServer();
   int DoConnectServerComplete(int result);
+  int ConnectServer(const NetworkIsolationKey& network_isolation_key,
+                    ClientSocketHandle* socket_handle,
+                    CompletionOnceCallback callback);
+  void StartHedge();
+  void OnHedgeComplete(int result);
   void Pull(Direction from, Direction to);
   void Push(Direction from, Direction to, int size);
   void Disconnect(Direction side);
@@ -88,10 +115,15 @@ class NaiveConnection {
   void OnBothDisconnected();
   void OnPullError(Direction from, Direction to, int error);
   void OnPushError(Direction from, Direction to, int error);
+  void OnPullReady(Direction from, Direction to, int result);
   void OnPullComplete(Direction from, Direction to, int result);
   void OnPushComplete(Direction from, Direction to, int result);
+  void UpdateReadSize(Direction from, int result);
+  bool CanSplice() const;
+  bool StartSplice();
+  void OnSpliceComplete(int result);
 
-  unsigned int id_;
+  uint64_t id_;
   ClientProtocol protocol_;
   std::unique_ptr<PaddingDetectorDelegate> padding_detector_delegate_;
   const ProxyInfo& proxy_info_;
@@ -99,7 +131,10 @@ class NaiveConnection {
   const SSLConfig& proxy_ssl_config_;
   RedirectResolver* resolver_;
   HttpNetworkSession* session_;
-  const NetworkIsolationKey& network_isolation_key_;
+  RelayBufferPool* buffer_pool_;
+  // Copied because the proxy may reassign its keys while connecting.
+  NetworkIsolationKey network_isolation_key_;
+  NetworkIsolationKey hedge_network_isolation_key_;
   const NetLogWithSource& net_log_;
 
   CompletionRepeatingCallback io_callback_;
@@ -111,6 +146,15 @@ class NaiveConnection {
   std::unique_ptr<StreamSocket> client_socket_;
   std::unique_ptr<ClientSocketHandle> server_socket_handle_;
 
+  // If connecting to the server takes longer than |hedge_delay_|, a second
+  // attempt through the session for |hedge_network_isolation_key_| races the
+  // first, and the slower one is cancelled. Zero disables hedging.
+  base::TimeDelta hedge_delay_;
+  base::OneShotTimer hedge_timer_;
+  std::unique_ptr<ClientSocketHandle> hedge_socket_handle_;
+  bool hedged_;
+  bool hedge_won_;
+
   StreamSocket* sockets_[kNumDirections];
   scoped_refptr<IOBuffer> read_buffers_[kNumDirections];
   scoped_refptr<DrainableIOBuffer> write_buffers_[kNumDirections];
@@ -118,6 +162,10 @@ class NaiveConnection {
   bool write_pending_[kNumDirections];
   int bytes_passed_without_yielding_[kNumDirections];
   base::TimeTicks yield_after_time_[kNumDirections];
+  // Buffer size of the next read from each side.
+  int read_sizes_[kNumDirections];
+  // Bytes requested by the last read from each side.
+  int last_read_sizes_[kNumDirections];
 
   bool early_pull_pending_;
   bool can_push_to_server_;
@@ -130,6 +178,20 @@ class NaiveConnection {
 
   bool full_duplex_;
 
+  HostPortPair origin_;
+  base::TimeTicks connect_start_time_;
+  base::TimeTicks client_connected_time_;
+  base::TimeTicks server_connect_start_time_;
+  base::TimeTicks server_connected_time_;
+  base::TimeTicks first_byte_time_;
+  int num_yields_;
+
+  // Indexed by the direction the data comes from.
+  int64_t bytes_copied_[kNumDirections];
+#if defined(OS_LINUX)
+  std::unique_ptr<SpliceRelay> splice_relay_;
+#endif
+
   TimeFunc time_func_;
 
   // Traffic annotation for socket control.
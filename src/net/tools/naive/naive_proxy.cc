@@ -11,27 +11,65 @@
 #include "base/location.h"
 #include "base/logging.h"
 #include "base/threading/thread_task_runner_handle.h"
+#include "base/values.h"
 #include "net/base/load_flags.h"
 #include "net/base/net_errors.h"
+#include "net/base/privacy_mode.h"
+#include "net/base/proxy_server.h"
+#include "net/dns/public/secure_dns_policy.h"
 #include "net/http/http_network_session.h"
 #include "net/proxy_resolution/configured_proxy_resolution_service.h"
 #include "net/proxy_resolution/proxy_config.h"
 #include "net/proxy_resolution/proxy_list.h"
+#include "net/quic/quic_chromium_client_session.h"
+#include "net/quic/quic_session_key.h"
+#include "net/quic/quic_stream_factory.h"
+#include "net/socket/client_socket_handle.h"
 #include "net/socket/client_socket_pool_manager.h"
+#include "net/socket/next_proto.h"
 #include "net/socket/server_socket.h"
+#include "net/socket/socket_tag.h"
 #include "net/socket/stream_socket.h"
+#include "net/spdy/spdy_session.h"
+#include "net/spdy/spdy_session_key.h"
+#include "net/spdy/spdy_session_pool.h"
 #include "net/tools/naive/http_proxy_socket.h"
 #include "net/tools/naive/naive_proxy_delegate.h"
 #include "net/tools/naive/socks5_server_socket.h"
+#include "net/tools/naive/tunnel_stats.h"
+#include "url/scheme_host_port.h"
+#include "url/url_constants.h"
 
 namespace net {
 
+namespace {
+// Bytes of idle relay buffers retained per thread.
+constexpr size_t kMaxFreeRelayBufferBytes = 4 * 1024 * 1024;
+
+// Connection IDs hold a 20-bit slot index and a 44-bit slot generation. The
+// generation is too wide to wrap, so IDs are never reused and are safe to
+// correlate in logs.
+constexpr int kSlotIndexBits = 20;
+constexpr uint64_t kSlotIndexMask = (uint64_t{1} << kSlotIndexBits) - 1;
+
+constexpr base::TimeDelta kLoadSampleInterval = base::Seconds(1);
+// A tunnel relaying this much counts as much as one more open stream when
+// comparing sessions, so bulk tunnels spread out before interactive ones.
+constexpr int64_t kBytesPerSecondPerStream = 64 * 1024;
+}  // namespace
+
 NaiveProxy::NaiveProxy(std::unique_ptr<ServerSocket> listen_socket,
                        ClientProtocol protocol,
                        const std::string& listen_user,
                        const std::string& listen_pass,
                        int concurrency,
+                       int max_read_size,
+                       int max_connecting,
+                       int max_tunnels,
+                       bool standby_session,
+                       base::TimeDelta hedge_delay,
                        RedirectResolver* resolver,
+                       TunnelStats* tunnel_stats,
                        HttpNetworkSession* session,
                        const NetworkTrafficAnnotationTag& traffic_annotation)
     : listen_socket_(std::move(listen_socket)),
@@ -39,11 +77,29 @@ NaiveProxy::NaiveProxy(std::unique_ptr<ServerSocket> listen_socket,
       listen_user_(listen_user),
       listen_pass_(listen_pass),
       concurrency_(concurrency),
+      max_connecting_(max_connecting),
+      max_tunnels_(max_tunnels),
       resolver_(resolver),
+      tunnel_stats_(tunnel_stats),
       session_(session),
       net_log_(
           NetLogWithSource::Make(session->net_log(), NetLogSourceType::NONE)),
-      last_id_(0),
+      accept_paused_(false),
+      num_connecting_(0),
+      num_running_(0),
+      num_accepted_(0),
+      num_accept_pauses_(0),
+      num_rejected_(0),
+      bytes_relayed_(0),
+      next_network_isolation_key_(0),
+      standby_session_(standby_session),
+      standby_key_(NetworkIsolationKey::CreateTransient()),
+      num_standby_promotions_(0),
+      hedge_delay_(hedge_delay),
+      hedge_key_(NetworkIsolationKey::CreateTransient()),
+      num_hedged_(0),
+      num_hedge_wins_(0),
+      buffer_pool_(max_read_size, kMaxFreeRelayBufferBytes),
       traffic_annotation_(traffic_annotation) {
   const auto& proxy_config = static_cast<ConfiguredProxyResolutionService*>(
                                  session_->proxy_resolution_service())
@@ -72,6 +128,19 @@ NaiveProxy::NaiveProxy(std::unique_ptr<ServerSocket> listen_socket,
   for (int i = 0; i < concurrency_; i++) {
     network_isolation_keys_.push_back(NetworkIsolationKey::CreateTransient());
   }
+  key_loads_.resize(network_isolation_keys_.size());
+  if (network_isolation_keys_.size() > 1) {
+    load_sample_timer_.Start(FROM_HERE, kLoadSampleInterval,
+                             base::BindRepeating(&NaiveProxy::SampleKeyLoads,
+                                                 base::Unretained(this)));
+  }
+
+  // The standby connection is a plain TLS connection to the proxy server
+  // turned into an HTTP/2 session, which QUIC proxies do not use.
+  if (standby_session_ && !proxy_info_.proxy_server().is_https()) {
+    LOG(WARNING) << "Standby session requires an HTTPS proxy";
+    standby_session_ = false;
+  }
 
   DCHECK(listen_socket_);
   // Start accepting connections in next run loop in case when delegate is not
@@ -79,6 +148,11 @@ NaiveProxy::NaiveProxy(std::unique_ptr<ServerSocket> listen_socket,
   base::ThreadTaskRunnerHandle::Get()->PostTask(
       FROM_HERE, base::BindOnce(&NaiveProxy::DoAcceptLoop,
                                 weak_ptr_factory_.GetWeakPtr()));
+  if (standby_session_) {
+    base::ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, base::BindOnce(&NaiveProxy::MaybeWarmStandbySession,
+                                  weak_ptr_factory_.GetWeakPtr()));
+  }
 }
 
 NaiveProxy::~NaiveProxy() = default;
@@ -86,6 +160,16 @@ NaiveProxy::~NaiveProxy() = default;
 void NaiveProxy::DoAcceptLoop() {
   int result;
   do {
+    // Leaves new connections in the listen backlog until the tunnels being
+    // set up drain, so a connection storm does not become a tunnel storm.
+    if (IsConnectLimitReached()) {
+      accept_paused_ = true;
+      ++num_accept_pauses_;
+      VLOG(1) << "Accept paused with " << num_connecting_
+              << " connecting tunnels (" << num_accept_pauses_
+              << " pauses)";
+      return;
+    }
     result = listen_socket_->Accept(
         &accepted_socket_, base::BindRepeating(&NaiveProxy::OnAcceptComplete,
                                                weak_ptr_factory_.GetWeakPtr()));
@@ -106,9 +190,191 @@ void NaiveProxy::HandleAcceptResult(int result) {
     LOG(ERROR) << "Accept error: rv=" << result;
     return;
   }
+  ++num_accepted_;
+  if (max_tunnels_ > 0 && num_connecting_ + num_running_ >= max_tunnels_) {
+    ++num_rejected_;
+    LOG(WARNING) << "Connection rejected with " << num_running_
+                 << " running tunnels (" << num_rejected_ << " rejected)";
+    accepted_socket_.reset();
+    return;
+  }
   DoConnect();
 }
 
+bool NaiveProxy::IsConnectLimitReached() const {
+  return max_connecting_ > 0 && num_connecting_ >= max_connecting_;
+}
+
+void NaiveProxy::MaybeResumeAccept() {
+  if (!accept_paused_ || IsConnectLimitReached())
+    return;
+  accept_paused_ = false;
+  VLOG(1) << "Accept resumed with " << num_connecting_ << " connecting tunnels";
+  base::ThreadTaskRunnerHandle::Get()->PostTask(
+      FROM_HERE, base::BindOnce(&NaiveProxy::DoAcceptLoop,
+                                weak_ptr_factory_.GetWeakPtr()));
+}
+
+SpdySessionKey NaiveProxy::GetProxySessionKey(
+    const NetworkIsolationKey& nik) const {
+  // Matches HttpProxyConnectJob::CreateSpdySessionKey() for the tunnels
+  // created by InitSocketHandleForRawConnect2().
+  return SpdySessionKey(proxy_info_.proxy_server().host_port_pair(),
+                        ProxyServer::Direct(), PRIVACY_MODE_DISABLED,
+                        SpdySessionKey::IsProxySession::kTrue, SocketTag(),
+                        nik, SecureDnsPolicy::kDisable);
+}
+
+bool NaiveProxy::HasProxySession(const NetworkIsolationKey& nik) const {
+  return session_->spdy_session_pool()->HasAvailableSession(
+      GetProxySessionKey(nik), /*is_websocket=*/false);
+}
+
+void NaiveProxy::MaybeUseStandbySession(size_t key_index) {
+  if (!standby_session_)
+    return;
+  auto& nik = network_isolation_keys_[key_index];
+  if (!HasProxySession(nik) && HasProxySession(standby_key_)) {
+    std::swap(nik, standby_key_);
+    ++num_standby_promotions_;
+    VLOG(1) << "Standby session promoted (" << num_standby_promotions_
+            << " promotions)";
+  }
+  MaybeWarmStandbySession();
+}
+
+void NaiveProxy::MaybeWarmStandbySession() {
+  if (standby_socket_handle_ || HasProxySession(standby_key_))
+    return;
+
+  const HostPortPair& proxy = proxy_info_.proxy_server().host_port_pair();
+  ProxyInfo direct;
+  direct.UseDirect();
+  direct.set_traffic_annotation(
+      net::MutableNetworkTrafficAnnotationTag(traffic_annotation_));
+  standby_socket_handle_ = std::make_unique<ClientSocketHandle>();
+  int result = InitSocketHandleForHttpRequest(
+      url::SchemeHostPort(url::kHttpsScheme, proxy.host(), proxy.port()),
+      LOAD_IGNORE_LIMITS, IDLE, session_, direct, proxy_ssl_config_,
+      proxy_ssl_config_, PRIVACY_MODE_DISABLED, standby_key_,
+      SecureDnsPolicy::kDisable, SocketTag(), net_log_,
+      standby_socket_handle_.get(),
+      base::BindOnce(&NaiveProxy::OnStandbyConnectComplete,
+                     weak_ptr_factory_.GetWeakPtr()),
+      ClientSocketPool::ProxyAuthCallback());
+  if (result == ERR_IO_PENDING)
+    return;
+  OnStandbyConnectComplete(result);
+}
+
+void NaiveProxy::OnStandbyConnectComplete(int result) {
+  std::unique_ptr<ClientSocketHandle> socket_handle =
+      std::move(standby_socket_handle_);
+  if (result != OK) {
+    LOG(WARNING) << "Standby session failed: " << ErrorToShortString(result);
+    return;
+  }
+  if (socket_handle->socket()->GetNegotiatedProtocol() != kProtoHTTP2) {
+    LOG(WARNING) << "Standby session failed: HTTP/2 not negotiated";
+    return;
+  }
+  // A hedged tunnel may have opened a session for the key in the meantime.
+  if (HasProxySession(standby_key_))
+    return;
+
+  base::WeakPtr<SpdySession> spdy_session;
+  result =
+      session_->spdy_session_pool()->CreateAvailableSessionFromSocketHandle(
+          GetProxySessionKey(standby_key_), std::move(socket_handle),
+          net_log_, &spdy_session);
+  if (result != OK) {
+    LOG(WARNING) << "Standby session failed: " << ErrorToShortString(result);
+    return;
+  }
+  VLOG(1) << "Standby session ready";
+}
+
+const NetworkIsolationKey& NaiveProxy::GetHedgeNetworkIsolationKey(
+    size_t key_index) const {
+  if (standby_session_)
+    return standby_key_;
+  if (network_isolation_keys_.size() > 1) {
+    return network_isolation_keys_[(key_index + 1) %
+                                   network_isolation_keys_.size()];
+  }
+  return hedge_key_;
+}
+
+size_t NaiveProxy::PickNetworkIsolationKey() {
+  size_t num_keys = network_isolation_keys_.size();
+  size_t start = next_network_isolation_key_;
+  next_network_isolation_key_ = (start + 1) % num_keys;
+
+  size_t best_index = start;
+  bool best_congested = false;
+  int64_t best_load = GetSessionLoad(start, &best_congested);
+  for (size_t i = 1; i < num_keys; ++i) {
+    size_t index = (start + i) % num_keys;
+    bool congested;
+    int64_t load = GetSessionLoad(index, &congested);
+    if (std::make_pair(congested, load) <
+        std::make_pair(best_congested, best_load)) {
+      best_index = index;
+      best_congested = congested;
+      best_load = load;
+    }
+  }
+  return best_index;
+}
+
+int64_t NaiveProxy::GetSessionLoad(size_t key_index, bool* congested) const {
+  const NetworkIsolationKey& nik = network_isolation_keys_[key_index];
+  int64_t num_streams = 0;
+  *congested = false;
+  if (proxy_info_.is_https()) {
+    base::WeakPtr<SpdySession> spdy_session =
+        session_->spdy_session_pool()->GetAvailableSession(
+            GetProxySessionKey(nik));
+    if (spdy_session) {
+      num_streams = spdy_session->num_open_streams();
+      *congested = spdy_session->IsSendStalled();
+    }
+  } else if (proxy_info_.is_quic()) {
+    // Matches HttpProxyConnectJob::DoQuicProxyCreateSession().
+    QuicChromiumClientSession* quic_session =
+        session_->quic_stream_factory()->FindActiveSession(QuicSessionKey(
+            proxy_info_.proxy_server().host_port_pair(), PRIVACY_MODE_DISABLED,
+            SocketTag(), nik, SecureDnsPolicy::kDisable));
+    if (quic_session) {
+      num_streams = quic_session->GetNumActiveStreams();
+      const auto& sent_packet_manager =
+          quic_session->connection()->sent_packet_manager();
+      *congested = sent_packet_manager.GetBytesInFlight() >=
+                   sent_packet_manager.GetCongestionWindowInBytes();
+    }
+  }
+  return num_streams +
+         key_loads_[key_index].bytes_per_second / kBytesPerSecondPerStream;
+}
+
+void NaiveProxy::SampleKeyLoads() {
+  std::vector<int64_t> bytes(key_loads_.size());
+  for (size_t i = 0; i < key_loads_.size(); ++i)
+    bytes[i] = key_loads_[i].closed_bytes;
+  for (const auto& slot : connection_slots_) {
+    if (slot.connection) {
+      bytes[slot.key_index] +=
+          slot.connection->bytes_copied() + slot.connection->bytes_spliced();
+    }
+  }
+  for (size_t i = 0; i < key_loads_.size(); ++i) {
+    auto& key_load = key_loads_[i];
+    key_load.bytes_per_second =
+        (bytes[i] - key_load.sampled_bytes) / kLoadSampleInterval.InSeconds();
+    key_load.sampled_bytes = bytes[i];
+  }
+}
+
 void NaiveProxy::DoConnect() {
   std::unique_ptr<StreamSocket> socket;
   auto* proxy_delegate =
@@ -124,23 +390,29 @@ void NaiveProxy::DoConnect() {
                                                   listen_user_, listen_pass_,
                                                   traffic_annotation_);
   } else if (protocol_ == ClientProtocol::kHttp) {
-    socket = std::make_unique<HttpProxySocket>(std::move(accepted_socket_),
-                                               padding_detector_delegate.get(),
-                                               traffic_annotation_);
+    socket = std::make_unique<HttpProxySocket>(
+        std::move(accepted_socket_), padding_detector_delegate.get(),
+        &buffer_pool_, traffic_annotation_);
   } else if (protocol_ == ClientProtocol::kRedir) {
     socket = std::move(accepted_socket_);
   } else {
     return;
   }
 
-  last_id_++;
-  const auto& nik = network_isolation_keys_[last_id_ % concurrency_];
+  size_t key_index = PickNetworkIsolationKey();
+  MaybeUseStandbySession(key_index);
+  uint64_t connection_id = AllocateConnectionId();
   auto connection_ptr = std::make_unique<NaiveConnection>(
-      last_id_, protocol_, std::move(padding_detector_delegate), proxy_info_,
-      server_ssl_config_, proxy_ssl_config_, resolver_, session_, nik, net_log_,
+      connection_id, protocol_, std::move(padding_detector_delegate),
+      proxy_info_, server_ssl_config_, proxy_ssl_config_, resolver_, session_,
+      &buffer_pool_, network_isolation_keys_[key_index],
+      GetHedgeNetworkIsolationKey(key_index), hedge_delay_, net_log_,
       std::move(socket), traffic_annotation_);
   auto* connection = connection_ptr.get();
-  connection_by_id_[connection->id()] = std::move(connection_ptr);
+  auto& slot = connection_slots_[connection_id & kSlotIndexMask];
+  slot.connection = std::move(connection_ptr);
+  slot.key_index = key_index;
+  ++num_connecting_;
   int result = connection->Connect(
       base::BindRepeating(&NaiveProxy::OnConnectComplete,
                           weak_ptr_factory_.GetWeakPtr(), connection->id()));
@@ -149,7 +421,7 @@ void NaiveProxy::DoConnect() {
   HandleConnectResult(connection, result);
 }
 
-void NaiveProxy::OnConnectComplete(unsigned int connection_id, int result) {
+void NaiveProxy::OnConnectComplete(uint64_t connection_id, int result) {
   auto* connection = FindConnection(connection_id);
   if (!connection)
     return;
@@ -157,10 +429,13 @@ void NaiveProxy::OnConnectComplete(unsigned int connection_id, int result) {
 }
 
 void NaiveProxy::HandleConnectResult(NaiveConnection* connection, int result) {
+  --num_connecting_;
+  MaybeResumeAccept();
   if (result != OK) {
     Close(connection->id(), result);
     return;
   }
+  ++num_running_;
   DoRun(connection);
 }
 
@@ -173,7 +448,7 @@ void NaiveProxy::DoRun(NaiveConnection* connection) {
   HandleRunResult(connection, result);
 }
 
-void NaiveProxy::OnRunComplete(unsigned int connection_id, int result) {
+void NaiveProxy::OnRunComplete(uint64_t connection_id, int result) {
   auto* connection = FindConnection(connection_id);
   if (!connection)
     return;
@@ -181,31 +456,105 @@ void NaiveProxy::OnRunComplete(unsigned int connection_id, int result) {
 }
 
 void NaiveProxy::HandleRunResult(NaiveConnection* connection, int result) {
+  --num_running_;
   Close(connection->id(), result);
 }
 
-void NaiveProxy::Close(unsigned int connection_id, int reason) {
-  auto it = connection_by_id_.find(connection_id);
-  if (it == connection_by_id_.end())
+void NaiveProxy::Close(uint64_t connection_id, int reason) {
+  auto* connection = FindConnection(connection_id);
+  if (!connection)
     return;
 
   LOG(INFO) << "Connection " << connection_id
-            << " closed: " << ErrorToShortString(reason);
+            << " closed: " << ErrorToShortString(reason) << ", copied "
+            << connection->bytes_copied() << " bytes, spliced "
+            << connection->bytes_spliced() << " bytes";
+  VLOG(1) << "Relay buffers: " << buffer_pool_.num_in_use() << " in use, "
+          << buffer_pool_.free_bytes() << " bytes free, "
+          << buffer_pool_.num_allocated() << " allocated, "
+          << buffer_pool_.num_reused() << " reused, "
+          << buffer_pool_.num_dropped() << " dropped";
 
+  TunnelStats::Record record;
+  connection->GetStats(&record);
+  record.result = reason;
+  tunnel_stats_->Add(record);
+  bytes_relayed_ += record.bytes[kClient] + record.bytes[kServer];
+  if (connection->hedged())
+    ++num_hedged_;
+  if (connection->hedge_won())
+    ++num_hedge_wins_;
+
+  size_t index = connection_id & kSlotIndexMask;
+  auto& slot = connection_slots_[index];
+  key_loads_[slot.key_index].closed_bytes +=
+      record.bytes[kClient] + record.bytes[kServer];
   // The call stack might have callbacks which still have the pointer of
   // connection. Instead of referencing connection with ID all the time,
   // destroys the connection in next run loop to make sure any pending
   // callbacks in the call stack return.
   base::ThreadTaskRunnerHandle::Get()->DeleteSoon(FROM_HERE,
-                                                  std::move(it->second));
-  connection_by_id_.erase(it);
+                                                  std::move(slot.connection));
+  ++slot.generation;
+  free_slots_.push_back(index);
 }
 
-NaiveConnection* NaiveProxy::FindConnection(unsigned int connection_id) {
-  auto it = connection_by_id_.find(connection_id);
-  if (it == connection_by_id_.end())
+NaiveProxy::Metrics NaiveProxy::GetMetrics() const {
+  Metrics metrics;
+  metrics.num_connecting = num_connecting_;
+  metrics.num_running = num_running_;
+  metrics.num_accepted = num_accepted_;
+  metrics.num_rejected = num_rejected_;
+  metrics.num_accept_pauses = num_accept_pauses_;
+  metrics.num_hedged = num_hedged_;
+  metrics.num_hedge_wins = num_hedge_wins_;
+  metrics.num_standby_promotions = num_standby_promotions_;
+  metrics.bytes_relayed = bytes_relayed_;
+  for (const auto& slot : connection_slots_) {
+    if (slot.connection) {
+      metrics.bytes_relayed +=
+          slot.connection->bytes_copied() + slot.connection->bytes_spliced();
+    }
+  }
+  metrics.num_spdy_sessions = session_->spdy_session_pool()->num_sessions();
+  metrics.spdy_session_stats =
+      session_->spdy_session_pool()->GetSessionStats();
+  metrics.num_quic_sessions = session_->quic_stream_factory()->num_sessions();
+  std::unique_ptr<base::Value> pools = session_->SocketPoolInfoToValue();
+  for (const base::Value& pool : pools->GetList()) {
+    metrics.num_handed_out_sockets +=
+        pool.FindIntKey("handed_out_socket_count").value_or(0);
+    metrics.num_connecting_sockets +=
+        pool.FindIntKey("connecting_socket_count").value_or(0);
+    metrics.num_idle_sockets +=
+        pool.FindIntKey("idle_socket_count").value_or(0);
+  }
+  if (base::ThreadTicks::IsSupported())
+    metrics.thread_cpu_time = base::ThreadTicks::Now().since_origin();
+  return metrics;
+}
+
+uint64_t NaiveProxy::AllocateConnectionId() {
+  size_t index;
+  if (!free_slots_.empty()) {
+    index = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    index = connection_slots_.size();
+    CHECK_LE(index, kSlotIndexMask);
+    connection_slots_.emplace_back();
+  }
+  return (connection_slots_[index].generation << kSlotIndexBits) | index;
+}
+
+NaiveConnection* NaiveProxy::FindConnection(uint64_t connection_id) {
+  size_t index = connection_id & kSlotIndexMask;
+  if (index >= connection_slots_.size())
+    return nullptr;
+  const auto& slot = connection_slots_[index];
+  if (slot.generation != connection_id >> kSlotIndexBits)
     return nullptr;
-  return it->second.get();
+  return slot.connection.get();
 }
 
 }  // namespace net
@@ -6,28 +6,34 @@
 #ifndef NET_TOOLS_NAIVE_NAIVE_PROXY_H_
 #define NET_TOOLS_NAIVE_NAIVE_PROXY_H_
 
-#include <map>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 #include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
 #include "net/base/completion_repeating_callback.h"
 #include "net/base/network_isolation_key.h"
 #include "net/log/net_log_with_source.h"
 #include "net/proxy_resolution/proxy_info.h"
+#include "net/spdy/spdy_session_stats.h"
 #include "net/ssl/ssl_config.h"
 #include "net/tools/naive/naive_connection.h"
 #include "net/tools/naive/naive_protocol.h"
+#include "net/tools/naive/relay_buffer_pool.h"
 
 namespace net {
 
 class ClientSocketHandle;
 class HttpNetworkSession;
+class SpdySessionKey;
 class NaiveConnection;
 class ServerSocket;
 class StreamSocket;
 struct NetworkTrafficAnnotationTag;
 class RedirectResolver;
+class TunnelStats;
 
 class NaiveProxy {
  public:
@@ -36,49 +42,156 @@ class NaiveProxy {
              const std::string& listen_user,
              const std::string& listen_pass,
              int concurrency,
+             int max_read_size,
+             int max_connecting,
+             int max_tunnels,
+             bool standby_session,
+             base::TimeDelta hedge_delay,
              RedirectResolver* resolver,
+             TunnelStats* tunnel_stats,
              HttpNetworkSession* session,
              const NetworkTrafficAnnotationTag& traffic_annotation);
   ~NaiveProxy();
   NaiveProxy(const NaiveProxy&) = delete;
   NaiveProxy& operator=(const NaiveProxy&) = delete;
 
+  // A snapshot of counters for the metrics endpoint.
+  struct Metrics {
+    int num_connecting = 0;
+    int num_running = 0;
+    uint64_t num_accepted = 0;
+    uint64_t num_rejected = 0;
+    uint64_t num_accept_pauses = 0;
+    uint64_t num_hedged = 0;
+    uint64_t num_hedge_wins = 0;
+    uint64_t num_standby_promotions = 0;
+    int64_t bytes_relayed = 0;
+    size_t num_spdy_sessions = 0;
+    size_t num_quic_sessions = 0;
+    SpdySessionStats spdy_session_stats;
+    int num_handed_out_sockets = 0;
+    int num_connecting_sockets = 0;
+    int num_idle_sockets = 0;
+    // CPU time of the IO thread, or zero if unsupported.
+    base::TimeDelta thread_cpu_time;
+  };
+
+  // Must be called on the thread running this proxy.
+  Metrics GetMetrics() const;
+
  private:
   void DoAcceptLoop();
   void OnAcceptComplete(int result);
   void HandleAcceptResult(int result);
+  bool IsConnectLimitReached() const;
+  void MaybeResumeAccept();
+
+  SpdySessionKey GetProxySessionKey(const NetworkIsolationKey& nik) const;
+  bool HasProxySession(const NetworkIsolationKey& nik) const;
+  void MaybeUseStandbySession(size_t key_index);
+  void MaybeWarmStandbySession();
+  void OnStandbyConnectComplete(int result);
+  const NetworkIsolationKey& GetHedgeNetworkIsolationKey(
+      size_t key_index) const;
+
+  // Returns the index of the least loaded network isolation key.
+  size_t PickNetworkIsolationKey();
+  // Returns how loaded the upstream session behind a key is, in units of
+  // open streams. Sets |congested| if it cannot send more right now.
+  int64_t GetSessionLoad(size_t key_index, bool* congested) const;
+  void SampleKeyLoads();
 
   void DoConnect();
-  void OnConnectComplete(unsigned int connection_id, int result);
+  void OnConnectComplete(uint64_t connection_id, int result);
   void HandleConnectResult(NaiveConnection* connection, int result);
 
   void DoRun(NaiveConnection* connection);
-  void OnRunComplete(unsigned int connection_id, int result);
+  void OnRunComplete(uint64_t connection_id, int result);
   void HandleRunResult(NaiveConnection* connection, int result);
 
-  void Close(unsigned int connection_id, int reason);
+  void Close(uint64_t connection_id, int reason);
 
-  NaiveConnection* FindConnection(unsigned int connection_id);
+  uint64_t AllocateConnectionId();
+  NaiveConnection* FindConnection(uint64_t connection_id);
 
   std::unique_ptr<ServerSocket> listen_socket_;
   ClientProtocol protocol_;
   std::string listen_user_;
   std::string listen_pass_;
   int concurrency_;
+  // Accepting pauses while |max_connecting_| tunnels are being set up, and
+  // connections beyond |max_tunnels_| tunnels are rejected. Zero means no
+  // limit.
+  int max_connecting_;
+  int max_tunnels_;
   ProxyInfo proxy_info_;
   SSLConfig server_ssl_config_;
   SSLConfig proxy_ssl_config_;
   RedirectResolver* resolver_;
+  TunnelStats* tunnel_stats_;
   HttpNetworkSession* session_;
   NetLogWithSource net_log_;
 
-  unsigned int last_id_;
-
   std::unique_ptr<StreamSocket> accepted_socket_;
+  bool accept_paused_;
 
-  std::vector<NetworkIsolationKey> network_isolation_keys_;
+  int num_connecting_;
+  int num_running_;
+  uint64_t num_accepted_;
+  uint64_t num_accept_pauses_;
+  uint64_t num_rejected_;
+  // Bytes relayed by closed connections.
+  int64_t bytes_relayed_;
 
-  std::map<unsigned int, std::unique_ptr<NaiveConnection>> connection_by_id_;
+  std::vector<NetworkIsolationKey> network_isolation_keys_;
+  size_t next_network_isolation_key_;
+
+  // Throughput of the tunnels using each network isolation key, sampled
+  // periodically. Ties in session load go round-robin from
+  // |next_network_isolation_key_|.
+  struct KeyLoad {
+    // Bytes relayed by closed tunnels.
+    int64_t closed_bytes = 0;
+    // Bytes relayed by all tunnels at the last sample.
+    int64_t sampled_bytes = 0;
+    int64_t bytes_per_second = 0;
+  };
+  std::vector<KeyLoad> key_loads_;
+  base::RepeatingTimer load_sample_timer_;
+
+  // With |standby_session_|, an HTTP/2 session to the proxy server is kept
+  // open under |standby_key_|. When a tunnel finds no session for its key,
+  // the keys are swapped so it uses the standby session right away, and a
+  // new standby session is opened.
+  bool standby_session_;
+  NetworkIsolationKey standby_key_;
+  // Set while the standby connection is being established.
+  std::unique_ptr<ClientSocketHandle> standby_socket_handle_;
+  uint64_t num_standby_promotions_;
+
+  // Tunnels still connecting after |hedge_delay_| race a second attempt
+  // through another session. Zero disables hedging.
+  base::TimeDelta hedge_delay_;
+  // Used for hedging when there is neither a standby key nor another key.
+  NetworkIsolationKey hedge_key_;
+  uint64_t num_hedged_;
+  uint64_t num_hedge_wins_;
+
+  // Declared before the connections so it outlives their buffers.
+  RelayBufferPool buffer_pool_;
+
+  // Connections are owned by a generational slot table. The low bits of a
+  // connection ID index |connection_slots_| and the high bits carry the slot
+  // generation, which changes on every reuse so stale IDs never match.
+  struct ConnectionSlot {
+    std::unique_ptr<NaiveConnection> connection;
+    // Starts at one so that no connection ID is zero.
+    uint64_t generation = 1;
+    // Index of the network isolation key used by the connection.
+    size_t key_index = 0;
+  };
+  std::vector<ConnectionSlot> connection_slots_;
+  std::vector<size_t> free_slots_;
 
   const NetworkTrafficAnnotationTag& traffic_annotation_;
 
@@ -8,8 +8,10 @@
 #include <limits>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "base/at_exit.h"
+#include "base/bind.h"
 #include "base/command_line.h"
 #include "base/feature_list.h"
 #include "base/files/file_path.h"
@@ -19,16 +21,24 @@
 #include "base/rand_util.h"
 #include "base/run_loop.h"
 #include "base/strings/escape.h"
+#include "base/strings/strcat.h"
 #include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
 #include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversions.h"
+#include "base/synchronization/waitable_event.h"
 #include "base/system/sys_info.h"
 #include "base/task/single_thread_task_executor.h"
 #include "base/task/thread_pool/thread_pool_instance.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/thread.h"
+#include "base/threading/thread_task_runner_handle.h"
 #include "base/values.h"
 #include "build/build_config.h"
 #include "components/version_info/version_info.h"
 #include "net/base/auth.h"
+#include "net/base/ip_address.h"
+#include "net/base/ip_endpoint.h"
 #include "net/base/network_isolation_key.h"
 #include "net/base/url_util.h"
 #include "net/cert/cert_verifier.h"
@@ -50,16 +60,28 @@
 #include "net/proxy_resolution/proxy_config.h"
 #include "net/proxy_resolution/proxy_config_service_fixed.h"
 #include "net/proxy_resolution/proxy_config_with_annotation.h"
+#include "net/quic/quic_context.h"
 #include "net/socket/client_socket_pool_manager.h"
+#include "net/socket/socket_options.h"
 #include "net/socket/ssl_client_socket.h"
 #include "net/socket/tcp_server_socket.h"
+#include "net/socket/tcp_socket.h"
 #include "net/socket/udp_server_socket.h"
+#include "net/spdy/spdy_session.h"
+#include "net/spdy/spdy_session_pool.h"
 #include "net/ssl/ssl_key_logger_impl.h"
+#include "net/third_party/quiche/src/quic/core/crypto/crypto_protocol.h"
+#include "net/third_party/quiche/src/quic/core/quic_tag.h"
 #include "net/third_party/quiche/src/quic/core/quic_versions.h"
+#include "net/third_party/quiche/src/quic/platform/api/quic_flags.h"
+#include "net/tools/naive/io_thread_monitor.h"
+#include "net/tools/naive/metrics_server.h"
 #include "net/tools/naive/naive_protocol.h"
 #include "net/tools/naive/naive_proxy.h"
 #include "net/tools/naive/naive_proxy_delegate.h"
 #include "net/tools/naive/redirect_resolver.h"
+#include "net/tools/naive/relay_buffer_pool.h"
+#include "net/tools/naive/tunnel_stats.h"
 #include "net/traffic_annotation/network_traffic_annotation.h"
 #include "net/url_request/url_request_context.h"
 #include "net/url_request/url_request_context_builder.h"
@@ -77,6 +99,14 @@ constexpr int kListenBackLog = 512;
 constexpr int kDefaultMaxSocketsPerPool = 256;
 constexpr int kDefaultMaxSocketsPerGroup = 255;
 constexpr int kExpectedMaxUsers = 8;
+constexpr int kDefaultMaxReadSize = 64 * 1024;
+// Four full-size TLS records per socket write.
+constexpr int kDefaultH2WriteSize = 64 * 1024;
+constexpr int kMaxH2WriteSize = 1024 * 1024;
+// Enough for one tunnel to fill 1 Gbit/s at 200 ms RTT with room to spare.
+constexpr int kDefaultH2WindowLimit = 64 * 1024 * 1024;
+// Tunnel statistics are aggregated over windows of this length.
+constexpr base::TimeDelta kStatsInterval = base::Seconds(60);
 constexpr net::NetworkTrafficAnnotationTag kTrafficAnnotation =
     net::DefineNetworkTrafficAnnotation("naive", "");
 
@@ -84,6 +114,18 @@ struct CommandLine {
   std::string listen;
   std::string proxy;
   std::string concurrency;
+  std::string threads;
+  std::string max_read_size;
+  std::string max_connecting;
+  std::string max_tunnels;
+  bool standby_session;
+  std::string hedge_delay;
+  std::string h2_write_size;
+  std::string h2_stream_window;
+  std::string h2_session_window;
+  std::string h2_window_limit;
+  std::string quic_congestion_control;
+  std::string quic_connection_options;
   std::string extra_headers;
   std::string host_resolver_rules;
   std::string resolver_range;
@@ -91,6 +133,8 @@ struct CommandLine {
   base::FilePath log;
   base::FilePath log_net_log;
   base::FilePath ssl_key_log_file;
+  base::FilePath stats_file;
+  std::string metrics_listen;
 };
 
 struct Params {
@@ -100,6 +144,21 @@ struct Params {
   std::string listen_addr;
   int listen_port;
   int concurrency;
+  int threads;
+  int max_read_size;
+  int max_connecting;
+  int max_tunnels;
+  bool standby_session;
+  // Zero disables hedging.
+  base::TimeDelta hedge_delay;
+  int h2_write_size;
+  // 0 keeps the default.
+  int h2_stream_window;
+  int h2_session_window;
+  int h2_window_limit;
+  // Options for the QUIC connections to the proxy server, including the
+  // congestion control choice. Only affect what naive sends.
+  quic::QuicTagVector quic_connection_options;
   net::HttpRequestHeaders extra_headers;
   std::string proxy_url;
   std::u16string proxy_user;
@@ -110,6 +169,8 @@ struct Params {
   logging::LoggingSettings log_settings;
   base::FilePath net_log_path;
   base::FilePath ssl_key_path;
+  base::FilePath stats_path;
+  net::IPEndPoint metrics_endpoint;
 };
 
 std::unique_ptr<base::Value> GetConstants() {
@@ -137,12 +198,29 @@ void GetCommandLine(const base::CommandLine& proc, CommandLine* cmdline) {
                  "--proxy=<proto>://[<user>:<pass>@]<hostname>[:<port>]\n"
                  "                           proto: https, quic\n"
                  "--insecure-concurrency=<N> Use N connections, insecure\n"
+                 "--threads=<N>              Use N IO threads (Linux only)\n"
+                 "--max-read-size=<N>        Max relay read size in bytes\n"
+                 "--max-connecting=<N>       Pause accepting at N connecting\n"
+                 "--max-tunnels=<N>          Reject beyond N tunnels\n"
+                 "--standby-session          Keep a spare proxy session\n"
+                 "--hedge-delay=<ms>         Race slow tunnel connects\n"
+                 "--h2-write-size=<N>        Max HTTP/2 bytes per write\n"
+                 "--h2-stream-window=<N>     HTTP/2 stream receive window\n"
+                 "--h2-session-window=<N>    HTTP/2 session receive window\n"
+                 "--h2-window-limit=<N>      Max auto-tuned HTTP/2 window\n"
+                 "--quic-congestion-control=<cubic|reno|bbr|bbr2>\n"
+                 "                           QUIC congestion control\n"
+                 "--quic-connection-options=<TAG>[,<TAG>...]\n"
+                 "                           QUIC connection options\n"
                  "--extra-headers=...        Extra headers split by CRLF\n"
                  "--host-resolver-rules=...  Resolver rules\n"
                  "--resolver-range=...       Redirect resolver range\n"
                  "--log[=<path>]             Log to stderr, or file\n"
                  "--log-net-log=<path>       Save NetLog\n"
                  "--ssl-key-log-file=<path>  Save SSL keys for Wireshark\n"
+                 "--stats-file=<path>        Save tunnel stats as JSON\n"
+                 "--metrics-listen=<addr>:<port>\n"
+                 "                           Serve metrics on loopback\n"
               << std::endl;
     exit(EXIT_SUCCESS);
   }
@@ -155,6 +233,20 @@ void GetCommandLine(const base::CommandLine& proc, CommandLine* cmdline) {
   cmdline->listen = proc.GetSwitchValueASCII("listen");
   cmdline->proxy = proc.GetSwitchValueASCII("proxy");
   cmdline->concurrency = proc.GetSwitchValueASCII("insecure-concurrency");
+  cmdline->threads = proc.GetSwitchValueASCII("threads");
+  cmdline->max_read_size = proc.GetSwitchValueASCII("max-read-size");
+  cmdline->max_connecting = proc.GetSwitchValueASCII("max-connecting");
+  cmdline->max_tunnels = proc.GetSwitchValueASCII("max-tunnels");
+  cmdline->standby_session = proc.HasSwitch("standby-session");
+  cmdline->hedge_delay = proc.GetSwitchValueASCII("hedge-delay");
+  cmdline->h2_write_size = proc.GetSwitchValueASCII("h2-write-size");
+  cmdline->h2_stream_window = proc.GetSwitchValueASCII("h2-stream-window");
+  cmdline->h2_session_window = proc.GetSwitchValueASCII("h2-session-window");
+  cmdline->h2_window_limit = proc.GetSwitchValueASCII("h2-window-limit");
+  cmdline->quic_congestion_control =
+      proc.GetSwitchValueASCII("quic-congestion-control");
+  cmdline->quic_connection_options =
+      proc.GetSwitchValueASCII("quic-connection-options");
   cmdline->extra_headers = proc.GetSwitchValueASCII("extra-headers");
   cmdline->host_resolver_rules =
       proc.GetSwitchValueASCII("host-resolver-rules");
@@ -163,6 +255,8 @@ void GetCommandLine(const base::CommandLine& proc, CommandLine* cmdline) {
   cmdline->log = proc.GetSwitchValuePath("log");
   cmdline->log_net_log = proc.GetSwitchValuePath("log-net-log");
   cmdline->ssl_key_log_file = proc.GetSwitchValuePath("ssl-key-log-file");
+  cmdline->stats_file = proc.GetSwitchValuePath("stats-file");
+  cmdline->metrics_listen = proc.GetSwitchValueASCII("metrics-listen");
 }
 
 void GetCommandLineFromConfig(const base::FilePath& config_path,
@@ -192,6 +286,54 @@ void GetCommandLineFromConfig(const base::FilePath& config_path,
   if (concurrency) {
     cmdline->concurrency = *concurrency;
   }
+  const auto* threads = value->FindStringKey("threads");
+  if (threads) {
+    cmdline->threads = *threads;
+  }
+  const auto* max_read_size = value->FindStringKey("max-read-size");
+  if (max_read_size) {
+    cmdline->max_read_size = *max_read_size;
+  }
+  const auto* max_connecting = value->FindStringKey("max-connecting");
+  if (max_connecting) {
+    cmdline->max_connecting = *max_connecting;
+  }
+  const auto* max_tunnels = value->FindStringKey("max-tunnels");
+  if (max_tunnels) {
+    cmdline->max_tunnels = *max_tunnels;
+  }
+  cmdline->standby_session =
+      value->FindBoolKey("standby-session").value_or(false);
+  const auto* hedge_delay = value->FindStringKey("hedge-delay");
+  if (hedge_delay) {
+    cmdline->hedge_delay = *hedge_delay;
+  }
+  const auto* h2_write_size = value->FindStringKey("h2-write-size");
+  if (h2_write_size) {
+    cmdline->h2_write_size = *h2_write_size;
+  }
+  const auto* h2_stream_window = value->FindStringKey("h2-stream-window");
+  if (h2_stream_window) {
+    cmdline->h2_stream_window = *h2_stream_window;
+  }
+  const auto* h2_session_window = value->FindStringKey("h2-session-window");
+  if (h2_session_window) {
+    cmdline->h2_session_window = *h2_session_window;
+  }
+  const auto* h2_window_limit = value->FindStringKey("h2-window-limit");
+  if (h2_window_limit) {
+    cmdline->h2_window_limit = *h2_window_limit;
+  }
+  const auto* quic_congestion_control =
+      value->FindStringKey("quic-congestion-control");
+  if (quic_congestion_control) {
+    cmdline->quic_congestion_control = *quic_congestion_control;
+  }
+  const auto* quic_connection_options =
+      value->FindStringKey("quic-connection-options");
+  if (quic_connection_options) {
+    cmdline->quic_connection_options = *quic_connection_options;
+  }
   const auto* extra_headers = value->FindStringKey("extra-headers");
   if (extra_headers) {
     cmdline->extra_headers = *extra_headers;
@@ -219,6 +361,14 @@ void GetCommandLineFromConfig(const base::FilePath& config_path,
     cmdline->ssl_key_log_file =
         base::FilePath::FromUTF8Unsafe(*ssl_key_log_file);
   }
+  const auto* stats_file = value->FindStringKey("stats-file");
+  if (stats_file) {
+    cmdline->stats_file = base::FilePath::FromUTF8Unsafe(*stats_file);
+  }
+  const auto* metrics_listen = value->FindStringKey("metrics-listen");
+  if (metrics_listen) {
+    cmdline->metrics_listen = *metrics_listen;
+  }
 }
 
 std::string GetProxyFromURL(const GURL& url) {
@@ -303,6 +453,140 @@ bool ParseCommandLine(const CommandLine& cmdline, Params* params) {
     params->concurrency = 1;
   }
 
+  if (!cmdline.threads.empty()) {
+    if (!base::StringToInt(cmdline.threads, &params->threads) ||
+        params->threads < 1) {
+      std::cerr << "Invalid threads" << std::endl;
+      return false;
+    }
+  } else {
+    params->threads = 1;
+  }
+  if (params->threads > 1) {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+    // The redirect resolver keeps its fake address mapping in memory, which
+    // cannot be shared by listeners on different threads.
+    if (params->protocol == net::ClientProtocol::kRedir) {
+      std::cerr << "Redir protocol does not support multiple threads"
+                << std::endl;
+      return false;
+    }
+#else
+    std::cerr << "Multiple threads only supports Linux." << std::endl;
+    return false;
+#endif
+  }
+
+  if (!cmdline.max_read_size.empty()) {
+    if (!base::StringToInt(cmdline.max_read_size, &params->max_read_size) ||
+        params->max_read_size < net::RelayBufferPool::kMinBufferSize ||
+        params->max_read_size > net::RelayBufferPool::kMaxBufferSize) {
+      std::cerr << "Invalid max read size" << std::endl;
+      return false;
+    }
+  } else {
+    params->max_read_size = kDefaultMaxReadSize;
+  }
+
+  params->max_connecting = 0;
+  if (!cmdline.max_connecting.empty()) {
+    if (!base::StringToInt(cmdline.max_connecting, &params->max_connecting) ||
+        params->max_connecting < 0) {
+      std::cerr << "Invalid max connecting" << std::endl;
+      return false;
+    }
+  }
+
+  params->max_tunnels = 0;
+  if (!cmdline.max_tunnels.empty()) {
+    if (!base::StringToInt(cmdline.max_tunnels, &params->max_tunnels) ||
+        params->max_tunnels < 0) {
+      std::cerr << "Invalid max tunnels" << std::endl;
+      return false;
+    }
+  }
+
+  params->standby_session = cmdline.standby_session;
+
+  if (!cmdline.hedge_delay.empty()) {
+    int hedge_delay_ms;
+    if (!base::StringToInt(cmdline.hedge_delay, &hedge_delay_ms) ||
+        hedge_delay_ms < 0) {
+      std::cerr << "Invalid hedge delay" << std::endl;
+      return false;
+    }
+    params->hedge_delay = base::Milliseconds(hedge_delay_ms);
+  }
+
+  if (!cmdline.h2_write_size.empty()) {
+    if (!base::StringToInt(cmdline.h2_write_size, &params->h2_write_size) ||
+        params->h2_write_size < 0 || params->h2_write_size > kMaxH2WriteSize) {
+      std::cerr << "Invalid HTTP/2 write size" << std::endl;
+      return false;
+    }
+  } else {
+    params->h2_write_size = kDefaultH2WriteSize;
+  }
+
+  params->h2_stream_window = 0;
+  if (!cmdline.h2_stream_window.empty()) {
+    if (!base::StringToInt(cmdline.h2_stream_window,
+                           &params->h2_stream_window) ||
+        params->h2_stream_window < net::kDefaultInitialWindowSize) {
+      std::cerr << "Invalid HTTP/2 stream window" << std::endl;
+      return false;
+    }
+  }
+
+  params->h2_session_window = 0;
+  if (!cmdline.h2_session_window.empty()) {
+    if (!base::StringToInt(cmdline.h2_session_window,
+                           &params->h2_session_window) ||
+        params->h2_session_window < net::kDefaultInitialWindowSize) {
+      std::cerr << "Invalid HTTP/2 session window" << std::endl;
+      return false;
+    }
+  }
+
+  if (!cmdline.h2_window_limit.empty()) {
+    if (!base::StringToInt(cmdline.h2_window_limit,
+                           &params->h2_window_limit) ||
+        params->h2_window_limit < 0) {
+      std::cerr << "Invalid HTTP/2 window limit" << std::endl;
+      return false;
+    }
+  } else {
+    params->h2_window_limit = kDefaultH2WindowLimit;
+  }
+
+  if (!cmdline.quic_congestion_control.empty()) {
+    const std::string& name = cmdline.quic_congestion_control;
+    if (name == "cubic") {
+      params->quic_connection_options.push_back(quic::kBYTE);
+    } else if (name == "reno") {
+      params->quic_connection_options.push_back(quic::kRENO);
+    } else if (name == "bbr") {
+      params->quic_connection_options.push_back(quic::kTBBR);
+    } else if (name == "bbr2") {
+      params->quic_connection_options.push_back(quic::kB2ON);
+    } else {
+      std::cerr << "Invalid QUIC congestion control" << std::endl;
+      return false;
+    }
+  }
+
+  if (!cmdline.quic_connection_options.empty()) {
+    for (const auto& tag : base::SplitStringPiece(
+             cmdline.quic_connection_options, ",", base::TRIM_WHITESPACE,
+             base::SPLIT_WANT_ALL)) {
+      if (tag.empty() || tag.size() > 4) {
+        std::cerr << "Invalid QUIC connection options" << std::endl;
+        return false;
+      }
+      params->quic_connection_options.push_back(quic::ParseQuicTag(tag));
+    }
+  }
+
   params->extra_headers.AddHeadersFromString(cmdline.extra_headers);
 
   params->host_resolver_rules = cmdline.host_resolver_rules;
@@ -336,6 +620,25 @@ bool ParseCommandLine(const CommandLine& cmdline, Params* params) {
 
   params->net_log_path = cmdline.log_net_log;
   params->ssl_key_path = cmdline.ssl_key_log_file;
+  params->stats_path = cmdline.stats_file;
+
+  if (!cmdline.metrics_listen.empty()) {
+    std::string host;
+    int port;
+    net::IPAddress address;
+    if (!net::ParseHostAndPort(cmdline.metrics_listen, &host, &port) ||
+        port <= 0 || port > std::numeric_limits<uint16_t>::max() ||
+        !address.AssignFromIPLiteral(host)) {
+      std::cerr << "Invalid metrics listen" << std::endl;
+      return false;
+    }
+    // The endpoint has no authentication.
+    if (!address.IsLoopback()) {
+      std::cerr << "Metrics listen address must be loopback" << std::endl;
+      return false;
+    }
+    params->metrics_endpoint = net::IPEndPoint(address, port);
+  }
 
   return true;
 }
@@ -352,7 +655,7 @@ class PrintingLogObserver : public NetLog::ThreadSafeObserver {
   PrintingLogObserver& operator=(const PrintingLogObserver&) = delete;
 
   ~PrintingLogObserver() override {
-    // This is guaranteed to be safe as this program is single threaded.
+    // This is guaranteed to be safe as the observer outlives all IO threads.
     net_log()->RemoveObserver(this);
   }
 
@@ -412,6 +715,19 @@ std::unique_ptr<URLRequestContext> BuildURLRequestContext(
   builder.DisableHttpCache();
   builder.set_net_log(net_log);
 
+  HttpNetworkSessionParams session_params;
+  session_params.spdy_session_write_coalescing_size = params.h2_write_size;
+  if (params.h2_stream_window) {
+    session_params.http2_settings[spdy::SETTINGS_INITIAL_WINDOW_SIZE] =
+        params.h2_stream_window;
+  }
+  if (params.h2_session_window) {
+    session_params.spdy_session_max_recv_window_size =
+        params.h2_session_window;
+  }
+  session_params.spdy_recv_window_auto_tuning_limit = params.h2_window_limit;
+  builder.set_http_network_session_params(session_params);
+
   ProxyConfig proxy_config;
   proxy_config.proxy_rules().ParseFromString(params.proxy_url);
   LOG(INFO) << "Proxying via " << params.proxy_url;
@@ -433,6 +749,16 @@ std::unique_ptr<URLRequestContext> BuildURLRequestContext(
   builder.set_proxy_delegate(
       std::make_unique<NaiveProxyDelegate>(params.extra_headers));
 
+  // QuicStreamFactory copies the connection options into its config when
+  // the context is built, so they must be set beforehand. They configure the
+  // local sender and are also sent to the server, which may apply them to
+  // its own sending.
+  auto quic_context = std::make_unique<QuicContext>();
+  quic_context->params()->connection_options = params.quic_connection_options;
+  quic_context->params()->client_connection_options =
+      params.quic_connection_options;
+  builder.set_quic_context(std::move(quic_context));
+
   auto context = builder.Build();
 
   if (!params.proxy_url.empty() && !params.proxy_user.empty() &&
@@ -458,6 +784,135 @@ std::unique_ptr<URLRequestContext> BuildURLRequestContext(
 
   return context;
 }
+
+// Listens with SO_REUSEPORT so that every IO thread has its own accept queue
+// on the same address and the kernel balances connections among them.
+int ListenWithReusePort(const IPEndPoint& endpoint,
+                        NetLog* net_log,
+                        std::unique_ptr<ServerSocket>* server_socket) {
+  auto socket =
+      std::make_unique<TCPSocket>(nullptr /* socket_performance_watcher */,
+                                  net_log, NetLogSource());
+  int result = socket->Open(endpoint.GetFamily());
+  if (result != OK)
+    return result;
+  result = socket->SetDefaultOptionsForServer();
+  if (result != OK)
+    return result;
+  result = SetReusePort(socket->SocketDescriptorForTesting(), true);
+  if (result != OK)
+    return result;
+  result = socket->Bind(endpoint);
+  if (result != OK)
+    return result;
+  result = socket->Listen(kListenBackLog);
+  if (result != OK)
+    return result;
+  *server_socket = std::make_unique<TCPServerSocket>(std::move(socket));
+  return OK;
+}
+
+// Owns a complete network stack serving one listen socket. Each IO thread
+// has its own instance, so instances share nothing but the NetLog.
+struct ProxyInstance {
+  std::unique_ptr<IOThreadMonitor> io_thread_monitor;
+  std::unique_ptr<URLRequestContext> cert_context;
+  std::unique_ptr<URLRequestContext> context;
+  std::unique_ptr<RedirectResolver> resolver;
+  std::unique_ptr<NaiveProxy> naive_proxy;
+};
+
+// Creates the proxy instance for the current thread. Returns false on error.
+bool StartProxyInstance(const Params& params,
+                        NetLog* net_log,
+                        TunnelStats* tunnel_stats,
+                        ProxyInstance* instance) {
+  std::string thread_name = base::PlatformThread::GetName();
+  instance->io_thread_monitor = std::make_unique<IOThreadMonitor>(
+      thread_name.empty() ? "main" : thread_name);
+  instance->io_thread_monitor->Start();
+
+  instance->cert_context = BuildCertURLRequestContext(net_log);
+  scoped_refptr<CertNetFetcherURLRequest> cert_net_fetcher;
+  // The builtin verifier is supported but not enabled by default on Mac,
+  // falling back to CreateSystemVerifyProc() which drops the net fetcher.
+  // Skips defined(OS_MAC) for now, until it is enabled by default.
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  cert_net_fetcher = base::MakeRefCounted<CertNetFetcherURLRequest>();
+  cert_net_fetcher->SetURLRequestContext(instance->cert_context.get());
+#endif
+  instance->context =
+      BuildURLRequestContext(params, std::move(cert_net_fetcher), net_log);
+  auto* session = instance->context->http_transaction_factory()->GetSession();
+  // SpdySession cannot call RecordYield(), so it counts its own yields.
+  instance->io_thread_monitor->SetExternalYieldsCallback(base::BindRepeating(
+      [](HttpNetworkSession* session) {
+        return session->spdy_session_pool()->GetSessionStats().num_read_yields;
+      },
+      base::Unretained(session)));
+
+  std::unique_ptr<ServerSocket> listen_socket;
+  int result;
+  if (params.threads > 1) {
+    IPAddress listen_addr;
+    if (!listen_addr.AssignFromIPLiteral(params.listen_addr)) {
+      LOG(ERROR) << "Failed to listen: " << ERR_ADDRESS_INVALID;
+      return false;
+    }
+    result = ListenWithReusePort(IPEndPoint(listen_addr, params.listen_port),
+                                 net_log, &listen_socket);
+  } else {
+    listen_socket = std::make_unique<TCPServerSocket>(net_log, NetLogSource());
+    result = listen_socket->ListenWithAddressAndPort(
+        params.listen_addr, params.listen_port, kListenBackLog);
+  }
+  if (result != OK) {
+    LOG(ERROR) << "Failed to listen: " << result;
+    return false;
+  }
+  LOG(INFO) << "Listening on " << params.listen_addr << ":"
+            << params.listen_port;
+
+  if (params.protocol == ClientProtocol::kRedir) {
+    auto resolver_socket =
+        std::make_unique<UDPServerSocket>(net_log, NetLogSource());
+    resolver_socket->AllowAddressReuse();
+    IPAddress listen_addr;
+    if (!listen_addr.AssignFromIPLiteral(params.listen_addr)) {
+      LOG(ERROR) << "Failed to open resolver: " << ERR_ADDRESS_INVALID;
+      return false;
+    }
+
+    result =
+        resolver_socket->Listen(IPEndPoint(listen_addr, params.listen_port));
+    if (result != OK) {
+      LOG(ERROR) << "Failed to open resolver: " << result;
+      return false;
+    }
+
+    instance->resolver = std::make_unique<RedirectResolver>(
+        std::move(resolver_socket), params.resolver_range,
+        params.resolver_prefix);
+  }
+
+  instance->naive_proxy = std::make_unique<NaiveProxy>(
+      std::move(listen_socket), params.protocol, params.listen_user,
+      params.listen_pass, params.concurrency, params.max_read_size,
+      params.max_connecting, params.max_tunnels, params.standby_session,
+      params.hedge_delay, instance->resolver.get(), tunnel_stats, session,
+      kTrafficAnnotation);
+  return true;
+}
+
+void StartProxyInstanceOnThread(const Params* params,
+                                NetLog* net_log,
+                                TunnelStats* tunnel_stats,
+                                ProxyInstance* instance,
+                                bool* success,
+                                base::WaitableEvent* done) {
+  *success = StartProxyInstance(*params, net_log, tunnel_stats, instance);
+  done->Signal();
+}
 }  // namespace
 }  // namespace net
 
@@ -505,6 +960,11 @@ int main(int argc, char* argv[]) {
       net::HttpNetworkSession::NORMAL_SOCKET_POOL,
       kDefaultMaxSocketsPerGroup * kExpectedMaxUsers);
 
+  if (quic::ContainsQuicTag(params.quic_connection_options, quic::kB2ON)) {
+    // Clients asking for BBRv2 are otherwise ignored.
+    SetQuicReloadableFlag(quic_allow_client_enabled_bbr_v2, true);
+  }
+
   CHECK(logging::InitLogging(params.log_settings));
 
   if (!params.ssl_key_path.empty()) {
@@ -532,60 +992,81 @@ int main(int argc, char* argv[]) {
                          net::NetLogCaptureMode::kDefault);
   }
 
-  auto cert_context = net::BuildCertURLRequestContext(net_log);
-  scoped_refptr<net::CertNetFetcherURLRequest> cert_net_fetcher;
-  // The builtin verifier is supported but not enabled by default on Mac,
-  // falling back to CreateSystemVerifyProc() which drops the net fetcher.
-  // Skips defined(OS_MAC) for now, until it is enabled by default.
-#if defined(OS_LINUX) || defined(OS_ANDROID)
-  cert_net_fetcher = base::MakeRefCounted<net::CertNetFetcherURLRequest>();
-  cert_net_fetcher->SetURLRequestContext(cert_context.get());
-#endif
-  auto context =
-      net::BuildURLRequestContext(params, std::move(cert_net_fetcher), net_log);
-  auto* session = context->http_transaction_factory()->GetSession();
-
-  auto listen_socket =
-      std::make_unique<net::TCPServerSocket>(net_log, net::NetLogSource());
+  // Shared by all IO threads and outlives their proxy instances.
+  net::TunnelStats tunnel_stats;
+  net::TunnelStatsReporter stats_reporter(&tunnel_stats, params.stats_path,
+                                          kStatsInterval);
+  stats_reporter.Start();
 
-  int result = listen_socket->ListenWithAddressAndPort(
-      params.listen_addr, params.listen_port, kListenBackLog);
-  if (result != net::OK) {
-    LOG(ERROR) << "Failed to listen: " << result;
+  net::ProxyInstance main_instance;
+  if (!net::StartProxyInstance(params, net_log, &tunnel_stats,
+                               &main_instance)) {
     return EXIT_FAILURE;
   }
-  LOG(INFO) << "Listening on " << params.listen_addr << ":"
-            << params.listen_port;
 
-  std::unique_ptr<net::RedirectResolver> resolver;
-  if (params.protocol == net::ClientProtocol::kRedir) {
-    auto resolver_socket =
-        std::make_unique<net::UDPServerSocket>(net_log, net::NetLogSource());
-    resolver_socket->AllowAddressReuse();
-    net::IPAddress listen_addr;
-    if (!listen_addr.AssignFromIPLiteral(params.listen_addr)) {
-      LOG(ERROR) << "Failed to open resolver: " << net::ERR_ADDRESS_INVALID;
-      return EXIT_FAILURE;
+  // Additional IO threads run fully independent proxy instances, each with
+  // its own listen socket sharing the port via SO_REUSEPORT.
+  std::vector<std::unique_ptr<base::Thread>> io_threads;
+  std::vector<std::unique_ptr<net::ProxyInstance>> instances;
+  int exit_code = EXIT_SUCCESS;
+  for (int i = 1; i < params.threads; i++) {
+    auto thread = std::make_unique<base::Thread>(
+        base::StrCat({"naive_io_", base::NumberToString(i)}));
+    CHECK(thread->StartWithOptions(
+        base::Thread::Options(base::MessagePumpType::IO, 0)));
+    auto instance = std::make_unique<net::ProxyInstance>();
+    bool success = false;
+    base::WaitableEvent done;
+    thread->task_runner()->PostTask(
+        FROM_HERE,
+        base::BindOnce(&net::StartProxyInstanceOnThread, &params, net_log,
+                       &tunnel_stats, instance.get(), &success, &done));
+    done.Wait();
+    io_threads.push_back(std::move(thread));
+    instances.push_back(std::move(instance));
+    if (!success) {
+      exit_code = EXIT_FAILURE;
+      break;
     }
+  }
 
-    result = resolver_socket->Listen(
-        net::IPEndPoint(listen_addr, params.listen_port));
+  std::unique_ptr<net::MetricsServer> metrics_server;
+  if (exit_code == EXIT_SUCCESS &&
+      !params.metrics_endpoint.address().empty()) {
+    auto metrics_socket =
+        std::make_unique<net::TCPServerSocket>(net_log, net::NetLogSource());
+    int result =
+        metrics_socket->Listen(params.metrics_endpoint, kListenBackLog);
     if (result != net::OK) {
-      LOG(ERROR) << "Failed to open resolver: " << result;
-      return EXIT_FAILURE;
+      LOG(ERROR) << "Failed to listen for metrics: " << result;
+      exit_code = EXIT_FAILURE;
+    } else {
+      LOG(INFO) << "Serving metrics on "
+                << params.metrics_endpoint.ToString();
+      std::vector<net::MetricsServer::Source> sources;
+      sources.emplace_back(base::ThreadTaskRunnerHandle::Get(),
+                           main_instance.naive_proxy.get());
+      for (size_t i = 0; i < io_threads.size(); i++) {
+        sources.emplace_back(io_threads[i]->task_runner(),
+                             instances[i]->naive_proxy.get());
+      }
+      metrics_server = std::make_unique<net::MetricsServer>(
+          std::move(metrics_socket), std::move(sources), kTrafficAnnotation);
     }
+  }
 
-    resolver = std::make_unique<net::RedirectResolver>(
-        std::move(resolver_socket), params.resolver_range,
-        params.resolver_prefix);
+  if (exit_code == EXIT_SUCCESS) {
+    base::RunLoop().Run();
   }
 
-  net::NaiveProxy naive_proxy(std::move(listen_socket), params.protocol,
-                              params.listen_user, params.listen_pass,
-                              params.concurrency, resolver.get(), session,
-                              kTrafficAnnotation);
+  // Goes before the proxies it reads from.
+  metrics_server.reset();
 
-  base::RunLoop().Run();
+  for (size_t i = 0; i < io_threads.size(); i++) {
+    io_threads[i]->task_runner()->DeleteSoon(FROM_HERE,
+                                             std::move(instances[i]));
+    io_threads[i]->Stop();
+  }
 
-  return EXIT_SUCCESS;
+  return exit_code;
 }
@@ -0,0 +1,100 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "net/tools/naive/relay_buffer_pool.h"
+
+#include <utility>
+
+#include "base/check_op.h"
+#include "net/base/io_buffer.h"
+
+namespace net {
+
+namespace {
+int GetSizeClass(int size) {
+  int size_class = 0;
+  while ((RelayBufferPool::kMinBufferSize << size_class) < size)
+    ++size_class;
+  return size_class;
+}
+
+int GetClassSize(int size_class) {
+  return RelayBufferPool::kMinBufferSize << size_class;
+}
+}  // namespace
+
+// Hands its memory back to the pool on destruction, or frees it if the pool
+// is already gone.
+class RelayBufferPool::PooledIOBuffer : public IOBuffer {
+ public:
+  PooledIOBuffer(int size_class,
+                 std::unique_ptr<char[]> data,
+                 base::WeakPtr<RelayBufferPool> pool)
+      : IOBuffer(data.release()),
+        size_class_(size_class),
+        pool_(std::move(pool)) {}
+
+ private:
+  ~PooledIOBuffer() override {
+    std::unique_ptr<char[]> data(data_.get());
+    data_ = nullptr;
+    if (pool_)
+      pool_->Release(size_class_, std::move(data));
+  }
+
+  int size_class_;
+  base::WeakPtr<RelayBufferPool> pool_;
+};
+
+RelayBufferPool::RelayBufferPool(int max_buffer_size, size_t max_free_bytes)
+    : max_buffer_size_(GetClassSize(GetSizeClass(max_buffer_size))),
+      max_free_bytes_(max_free_bytes),
+      free_bytes_(0),
+      num_allocated_(0),
+      num_reused_(0),
+      num_dropped_(0),
+      num_in_use_(0) {
+  DCHECK_GE(max_buffer_size, kMinBufferSize);
+  DCHECK_LE(max_buffer_size, kMaxBufferSize);
+  DCHECK_EQ(GetClassSize(kNumSizeClasses - 1), kMaxBufferSize);
+}
+
+RelayBufferPool::~RelayBufferPool() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+scoped_refptr<IOBuffer> RelayBufferPool::Get(int size) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  DCHECK_GT(size, 0);
+  DCHECK_LE(size, max_buffer_size_);
+  int size_class = GetSizeClass(size);
+  auto& free_buffers = free_buffers_[size_class];
+  std::unique_ptr<char[]> data;
+  if (!free_buffers.empty()) {
+    data = std::move(free_buffers.back());
+    free_buffers.pop_back();
+    free_bytes_ -= GetClassSize(size_class);
+    ++num_reused_;
+  } else {
+    data.reset(new char[GetClassSize(size_class)]);
+    ++num_allocated_;
+  }
+  ++num_in_use_;
+  return base::MakeRefCounted<PooledIOBuffer>(size_class, std::move(data),
+                                              weak_ptr_factory_.GetWeakPtr());
+}
+
+void RelayBufferPool::Release(int size_class, std::unique_ptr<char[]> data) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  DCHECK_GT(num_in_use_, 0u);
+  --num_in_use_;
+  size_t size = GetClassSize(size_class);
+  if (free_bytes_ + size > max_free_bytes_) {
+    ++num_dropped_;
+    return;
+  }
+  free_bytes_ += size;
+  free_buffers_[size_class].push_back(std::move(data));
+}
+
+}  // namespace net
@@ -0,0 +1,75 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef NET_TOOLS_NAIVE_RELAY_BUFFER_POOL_H_
+#define NET_TOOLS_NAIVE_RELAY_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "base/memory/scoped_refptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/sequence_checker.h"
+
+namespace net {
+
+class IOBuffer;
+
+// Free lists of relay buffers for one thread. Sizes are rounded up to powers
+// of two between kMinBufferSize and max_buffer_size(). Buffers returned by
+// Get() give their memory back to the pool when the last reference goes away,
+// so the relay hot path does not malloc and free for every read. At most
+// |max_free_bytes| of idle buffers are retained; the rest are freed.
+class RelayBufferPool {
+ public:
+  static constexpr int kMinBufferSize = 4 * 1024;
+  static constexpr int kMaxBufferSize = 256 * 1024;
+
+  RelayBufferPool(int max_buffer_size, size_t max_free_bytes);
+  ~RelayBufferPool();
+  RelayBufferPool(const RelayBufferPool&) = delete;
+  RelayBufferPool& operator=(const RelayBufferPool&) = delete;
+
+  // Returns a buffer of at least |size| bytes. |size| must not exceed
+  // max_buffer_size().
+  scoped_refptr<IOBuffer> Get(int size);
+
+  int max_buffer_size() const { return max_buffer_size_; }
+
+  // Buffers allocated from the heap.
+  uint64_t num_allocated() const { return num_allocated_; }
+  // Get() calls served from a free list.
+  uint64_t num_reused() const { return num_reused_; }
+  // Released buffers freed because the free lists were full.
+  uint64_t num_dropped() const { return num_dropped_; }
+  // Buffers currently referenced by their users.
+  size_t num_in_use() const { return num_in_use_; }
+  // Bytes of idle buffers held by the pool.
+  size_t free_bytes() const { return free_bytes_; }
+
+ private:
+  class PooledIOBuffer;
+
+  static constexpr int kNumSizeClasses = 7;
+
+  void Release(int size_class, std::unique_ptr<char[]> data);
+
+  const int max_buffer_size_;
+  const size_t max_free_bytes_;
+  std::vector<std::unique_ptr<char[]>> free_buffers_[kNumSizeClasses];
+  size_t free_bytes_;
+
+  uint64_t num_allocated_;
+  uint64_t num_reused_;
+  uint64_t num_dropped_;
+  size_t num_in_use_;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+
+  base::WeakPtrFactory<RelayBufferPool> weak_ptr_factory_{this};
+};
+
+}  // namespace net
+#endif  // NET_TOOLS_NAIVE_RELAY_BUFFER_POOL_H_
@@ -43,6 +43,10 @@ class Socks5ServerSocket : public StreamSocket {
 
   const HostPortPair& request_endpoint() const;
 
+  // The underlying socket. No data is buffered in this class after the
+  // handshake, so the transport can be used directly for relaying.
+  StreamSocket* transport_socket() const { return transport_.get(); }
+
   // StreamSocket implementation.
 
   // Does the SOCKS handshake and completes the protocol.
@@ -0,0 +1,164 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "net/tools/naive/splice_relay.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/task/current_thread.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "net/base/net_errors.h"
+#include "net/spdy/spdy_session.h"
+#include "net/tools/naive/io_thread_monitor.h"
+
+namespace net {
+
+namespace {
+// The default pipe capacity on Linux.
+constexpr size_t kPipeSize = 64 * 1024;
+
+Direction Opposite(Direction side) {
+  return side == kClient ? kServer : kClient;
+}
+}  // namespace
+
+SpliceRelay::SpliceRelay(int client_fd, int server_fd)
+    : fds_{client_fd, server_fd},
+      pipe_bytes_{0, 0},
+      bytes_relayed_{0, 0},
+      num_yields_(0),
+      error_side_(kClient) {
+  for (int i = 0; i < kNumDirections; i++) {
+    read_watchers_[i] =
+        std::make_unique<base::MessagePumpForIO::FdWatchController>(FROM_HERE);
+    write_watchers_[i] =
+        std::make_unique<base::MessagePumpForIO::FdWatchController>(FROM_HERE);
+  }
+}
+
+SpliceRelay::~SpliceRelay() = default;
+
+int SpliceRelay::Init() {
+  for (int i = 0; i < kNumDirections; i++) {
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0)
+      return MapSystemError(errno);
+    pipe_read_[i].reset(fds[0]);
+    pipe_write_[i].reset(fds[1]);
+  }
+  return OK;
+}
+
+int SpliceRelay::Run(CompletionOnceCallback callback) {
+  DCHECK(!callback_);
+  DCHECK(pipe_read_[kClient].is_valid());
+
+  callback_ = std::move(callback);
+  DoRelay(kClient);
+  if (callback_)
+    DoRelay(kServer);
+  return ERR_IO_PENDING;
+}
+
+void SpliceRelay::OnFileCanReadWithoutBlocking(int fd) {
+  DoRelay(fd == fds_[kClient] ? kClient : kServer);
+}
+
+void SpliceRelay::OnFileCanWriteWithoutBlocking(int fd) {
+  // Writable |to| side resumes the direction flowing into it.
+  DoRelay(fd == fds_[kClient] ? kServer : kClient);
+}
+
+void SpliceRelay::DoRelay(Direction from) {
+  if (!callback_)
+    return;
+
+  Direction to = Opposite(from);
+  int bytes_passed_without_yielding = 0;
+  while (true) {
+    if (pipe_bytes_[from] == 0) {
+      ssize_t rv = HANDLE_EINTR(splice(fds_[from], nullptr,
+                                       pipe_write_[from].get(), nullptr,
+                                       kPipeSize,
+                                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK));
+      if (rv == 0) {
+        Finish(from, ERR_CONNECTION_CLOSED);
+        return;
+      }
+      if (rv < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          if (!WatchFileDescriptor(from, base::MessagePumpForIO::WATCH_READ,
+                                   read_watchers_[from].get())) {
+            Finish(from, MapSystemError(errno));
+          }
+          return;
+        }
+        Finish(from, MapSystemError(errno));
+        return;
+      }
+      pipe_bytes_[from] = rv;
+      if (first_read_times_[from].is_null())
+        first_read_times_[from] = base::TimeTicks::Now();
+    }
+
+    ssize_t rv = HANDLE_EINTR(splice(pipe_read_[from].get(), nullptr,
+                                     fds_[to], nullptr, pipe_bytes_[from],
+                                     SPLICE_F_MOVE | SPLICE_F_NONBLOCK));
+    if (rv < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (!WatchFileDescriptor(to, base::MessagePumpForIO::WATCH_WRITE,
+                                 write_watchers_[to].get())) {
+          Finish(to, MapSystemError(errno));
+        }
+        return;
+      }
+      Finish(to, MapSystemError(errno));
+      return;
+    }
+    pipe_bytes_[from] -= rv;
+    bytes_relayed_[from] += rv;
+    bytes_passed_without_yielding += rv;
+
+    // Yields like the copy path so one busy tunnel cannot starve the others.
+    if (bytes_passed_without_yielding > kYieldAfterBytesRead) {
+      ++num_yields_;
+      IOThreadMonitor::RecordYield();
+      base::ThreadTaskRunnerHandle::Get()->PostTask(
+          FROM_HERE, base::BindOnce(&SpliceRelay::DoRelay,
+                                    weak_ptr_factory_.GetWeakPtr(), from));
+      return;
+    }
+  }
+}
+
+bool SpliceRelay::WatchFileDescriptor(
+    Direction side,
+    base::MessagePumpForIO::Mode mode,
+    base::MessagePumpForIO::FdWatchController* watcher) {
+  if (!base::CurrentIOThread::Get()->WatchFileDescriptor(
+          fds_[side], /*persistent=*/false, mode, watcher, this)) {
+    PLOG(ERROR) << "WatchFileDescriptor failed on splice";
+    return false;
+  }
+  return true;
+}
+
+void SpliceRelay::Finish(Direction side, int result) {
+  error_side_ = side;
+  for (int i = 0; i < kNumDirections; i++) {
+    read_watchers_[i]->StopWatchingFileDescriptor();
+    write_watchers_[i]->StopWatchingFileDescriptor();
+  }
+  weak_ptr_factory_.InvalidateWeakPtrs();
+  std::move(callback_).Run(result);
+}
+
+}  // namespace net
@@ -0,0 +1,85 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef NET_TOOLS_NAIVE_SPLICE_RELAY_H_
+#define NET_TOOLS_NAIVE_SPLICE_RELAY_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "base/files/scoped_file.h"
+#include "base/memory/weak_ptr.h"
+#include "base/message_loop/message_pump_for_io.h"
+#include "base/time/time.h"
+#include "net/base/completion_once_callback.h"
+#include "net/tools/naive/naive_protocol.h"
+
+namespace net {
+
+// Relays data between two connected TCP sockets with splice(2) through one
+// pipe per direction, so payload bytes never get copied to userspace. Only
+// usable when both sides are plain TCP without any framing or padding.
+// The descriptors are borrowed and must outlive this object.
+class SpliceRelay : public base::MessagePumpForIO::FdWatcher {
+ public:
+  SpliceRelay(int client_fd, int server_fd);
+  ~SpliceRelay() override;
+  SpliceRelay(const SpliceRelay&) = delete;
+  SpliceRelay& operator=(const SpliceRelay&) = delete;
+
+  // Creates the pipes. Returns a net error code if splicing is unavailable,
+  // in which case the caller should fall back to copying.
+  int Init();
+
+  // Starts relaying in both directions. Returns ERR_IO_PENDING and runs
+  // |callback| once either side is closed or fails. A clean close is reported
+  // as ERR_CONNECTION_CLOSED.
+  int Run(CompletionOnceCallback callback);
+
+  // The side whose socket was closed or failed. Valid once the callback
+  // passed to Run() has been called.
+  Direction error_side() const { return error_side_; }
+
+  // Bytes moved from |from| to the opposite side.
+  int64_t bytes_relayed(Direction from) const { return bytes_relayed_[from]; }
+  // When the first byte from |from| was read, or null if none was.
+  base::TimeTicks first_read_time(Direction from) const {
+    return first_read_times_[from];
+  }
+  // Times relaying yielded to other tasks.
+  int num_yields() const { return num_yields_; }
+
+  // base::MessagePumpForIO::FdWatcher methods.
+  void OnFileCanReadWithoutBlocking(int fd) override;
+  void OnFileCanWriteWithoutBlocking(int fd) override;
+
+ private:
+  void DoRelay(Direction from);
+  bool WatchFileDescriptor(Direction side,
+                           base::MessagePumpForIO::Mode mode,
+                           base::MessagePumpForIO::FdWatchController* watcher);
+  void Finish(Direction side, int result);
+
+  int fds_[kNumDirections];
+  // Indexed by the direction the data comes from.
+  base::ScopedFD pipe_read_[kNumDirections];
+  base::ScopedFD pipe_write_[kNumDirections];
+  int pipe_bytes_[kNumDirections];
+  int64_t bytes_relayed_[kNumDirections];
+  base::TimeTicks first_read_times_[kNumDirections];
+  int num_yields_;
+  Direction error_side_;
+
+  // Indexed by the side being watched.
+  std::unique_ptr<base::MessagePumpForIO::FdWatchController>
+      read_watchers_[kNumDirections];
+  std::unique_ptr<base::MessagePumpForIO::FdWatchController>
+      write_watchers_[kNumDirections];
+
+  CompletionOnceCallback callback_;
+
+  base::WeakPtrFactory<SpliceRelay> weak_ptr_factory_{this};
+};
+
+}  // namespace net
+#endif  // NET_TOOLS_NAIVE_SPLICE_RELAY_H_
@@ -0,0 +1,375 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#include "net/tools/naive/tunnel_stats.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/bits.h"
+#include "base/files/important_file_writer.h"
+#include "base/json/json_writer.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/metrics/statistics_recorder.h"
+#include "base/task/task_traits.h"
+#include "base/task/thread_pool.h"
+
+#if defined(OS_POSIX)
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "base/posix/eintr_wrapper.h"
+#include "base/task/current_thread.h"
+#endif
+
+namespace net {
+
+namespace {
+// Bounds the memory of per-origin statistics within one window. Origins
+// beyond this are counted under kOtherOrigins.
+constexpr size_t kMaxOriginsPerWindow = 4096;
+constexpr char kOtherOrigins[] = "(other)";
+constexpr size_t kMaxReportedOrigins = 20;
+
+int64_t ToMilliseconds(base::TimeDelta delta) {
+  return delta.InMilliseconds();
+}
+
+// Runs on a blocking-capable pool thread.
+void WriteStatsFile(const base::FilePath& path, const std::string& json) {
+  if (!base::ImportantFileWriter::WriteFileAtomically(path, json))
+    LOG(WARNING) << "Failed to write stats to " << path;
+}
+
+#if defined(OS_POSIX)
+int g_signal_write_fd = -1;
+
+void OnDumpSignal(int /*signal*/) {
+  int saved_errno = errno;
+  char c = 0;
+  // The pipe is non-blocking; a full pipe already has a dump pending.
+  static_cast<void>(HANDLE_EINTR(write(g_signal_write_fd, &c, 1)));
+  errno = saved_errno;
+}
+#endif
+}  // namespace
+
+LogHistogram::LogHistogram() : buckets_{}, count_(0), sum_(0), max_(0) {}
+
+void LogHistogram::Add(int64_t sample) {
+  if (sample < 0)
+    sample = 0;
+  int bucket = 0;
+  if (sample > 0) {
+    int bit_width = 64 - static_cast<int>(base::bits::CountLeadingZeroBits(
+                             static_cast<uint64_t>(sample)));
+    bucket = std::min(bit_width, kNumBuckets - 1);
+  }
+  ++buckets_[bucket];
+  ++count_;
+  sum_ += sample;
+  max_ = std::max(max_, sample);
+}
+
+void LogHistogram::Merge(const LogHistogram& other) {
+  for (int i = 0; i < kNumBuckets; i++)
+    buckets_[i] += other.buckets_[i];
+  count_ += other.count_;
+  sum_ += other.sum_;
+  max_ = std::max(max_, other.max_);
+}
+
+int64_t LogHistogram::Percentile(int percentile) const {
+  if (count_ == 0)
+    return 0;
+  // The rank of the sample, rounded up, counting from 1.
+  int64_t rank = (count_ * percentile + 99) / 100;
+  int64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; i++) {
+    seen += buckets_[i];
+    if (seen >= rank)
+      return std::min(i == 0 ? 0 : (int64_t{1} << i) - 1, max_);
+  }
+  return max_;
+}
+
+base::Value LogHistogram::ToValue() const {
+  base::Value dict(base::Value::Type::DICTIONARY);
+  dict.SetDoubleKey("count", count_);
+  dict.SetDoubleKey("mean", count_ ? static_cast<double>(sum_) / count_ : 0);
+  dict.SetDoubleKey("p50", Percentile(50));
+  dict.SetDoubleKey("p90", Percentile(90));
+  dict.SetDoubleKey("p99", Percentile(99));
+  dict.SetDoubleKey("max", max_);
+  return dict;
+}
+
+TunnelStats::Record::Record() = default;
+
+TunnelStats::Record::Record(const Record&) = default;
+
+TunnelStats::Record::~Record() = default;
+
+TunnelStats::Histograms::Histograms() = default;
+
+TunnelStats::Histograms::~Histograms() = default;
+
+void TunnelStats::Histograms::Add(const Record& record) {
+  if (record.result < 0)
+    ++errors;
+  if (record.client_connected)
+    client_connect_ms.Add(ToMilliseconds(record.client_connect_time));
+  if (record.server_connected)
+    server_connect_ms.Add(ToMilliseconds(record.server_connect_time));
+  if (record.has_first_byte)
+    first_byte_ms.Add(ToMilliseconds(record.first_byte_time));
+  duration_ms.Add(ToMilliseconds(record.duration));
+  bytes_sent.Add(record.bytes[kClient]);
+  bytes_received.Add(record.bytes[kServer]);
+  yields.Add(record.num_yields);
+}
+
+void TunnelStats::Histograms::Merge(const Histograms& other) {
+  errors += other.errors;
+  client_connect_ms.Merge(other.client_connect_ms);
+  server_connect_ms.Merge(other.server_connect_ms);
+  first_byte_ms.Merge(other.first_byte_ms);
+  duration_ms.Merge(other.duration_ms);
+  bytes_sent.Merge(other.bytes_sent);
+  bytes_received.Merge(other.bytes_received);
+  yields.Merge(other.yields);
+}
+
+base::Value TunnelStats::Histograms::ToValue() const {
+  base::Value dict(base::Value::Type::DICTIONARY);
+  dict.SetDoubleKey("tunnels", duration_ms.count());
+  dict.SetDoubleKey("errors", errors);
+  dict.SetKey("client_connect_ms", client_connect_ms.ToValue());
+  dict.SetKey("server_connect_ms", server_connect_ms.ToValue());
+  dict.SetKey("first_byte_ms", first_byte_ms.ToValue());
+  dict.SetKey("duration_ms", duration_ms.ToValue());
+  dict.SetKey("bytes_sent", bytes_sent.ToValue());
+  dict.SetKey("bytes_received", bytes_received.ToValue());
+  dict.SetKey("yields", yields.ToValue());
+  return dict;
+}
+
+TunnelStats::Window::Window() = default;
+
+TunnelStats::Window::~Window() = default;
+
+TunnelStats::TunnelStats()
+    : current_window_(0),
+      recent_start_time_(base::TimeTicks::Now()),
+      window_start_time_(recent_start_time_) {}
+
+TunnelStats::~TunnelStats() = default;
+
+void TunnelStats::Add(const Record& record) {
+  base::AutoLock lock(lock_);
+  totals_[record.tunnel_type].Add(record);
+
+  Window& window = windows_[current_window_];
+  window.by_type[record.tunnel_type].Add(record);
+
+  if (record.origin.empty())
+    return;
+  auto it = window.by_origin.find(record.origin);
+  if (it == window.by_origin.end()) {
+    std::string origin = record.origin;
+    if (window.by_origin.size() >= kMaxOriginsPerWindow)
+      origin = kOtherOrigins;
+    it = window.by_origin.emplace(origin, OriginStats()).first;
+  }
+  OriginStats& origin_stats = it->second;
+  ++origin_stats.count;
+  if (record.result < 0)
+    ++origin_stats.errors;
+  if (record.server_connected) {
+    ++origin_stats.num_connected;
+    origin_stats.total_server_connect_time += record.server_connect_time;
+  }
+  if (record.has_first_byte) {
+    ++origin_stats.num_first_bytes;
+    origin_stats.total_first_byte_time += record.first_byte_time;
+  }
+  origin_stats.bytes += record.bytes[kClient] + record.bytes[kServer];
+}
+
+void TunnelStats::Rotate() {
+  base::AutoLock lock(lock_);
+  current_window_ = (current_window_ + 1) % kNumWindows;
+  windows_[current_window_] = Window();
+  recent_start_time_ = window_start_time_;
+  window_start_time_ = base::TimeTicks::Now();
+}
+
+base::Value TunnelStats::ToValue() const {
+  base::AutoLock lock(lock_);
+
+  base::Value total(base::Value::Type::DICTIONARY);
+  for (const auto& entry : totals_)
+    total.SetKey(entry.first, entry.second.ToValue());
+
+  // The previous window is complete, so the recent view spans at least one
+  // full window.
+  const Window& previous = windows_[(current_window_ + 1) % kNumWindows];
+  const Window& current = windows_[current_window_];
+
+  std::map<std::string, Histograms> recent_by_type = previous.by_type;
+  for (const auto& entry : current.by_type)
+    recent_by_type[entry.first].Merge(entry.second);
+  base::Value recent(base::Value::Type::DICTIONARY);
+  for (const auto& entry : recent_by_type)
+    recent.SetKey(entry.first, entry.second.ToValue());
+
+  std::map<std::string, OriginStats> recent_by_origin = previous.by_origin;
+  for (const auto& entry : current.by_origin) {
+    const OriginStats& stats = entry.second;
+    OriginStats& merged = recent_by_origin[entry.first];
+    merged.count += stats.count;
+    merged.errors += stats.errors;
+    merged.num_connected += stats.num_connected;
+    merged.total_server_connect_time += stats.total_server_connect_time;
+    merged.num_first_bytes += stats.num_first_bytes;
+    merged.total_first_byte_time += stats.total_first_byte_time;
+    merged.bytes += stats.bytes;
+  }
+
+  // Ranks origins by mean upstream connect time, which is where a slow
+  // proxy path or a slow origin shows up first.
+  using OriginEntry = std::pair<double, const std::string*>;
+  std::vector<OriginEntry> ranked;
+  for (const auto& entry : recent_by_origin) {
+    const OriginStats& stats = entry.second;
+    if (stats.num_connected == 0)
+      continue;
+    double mean_ms =
+        stats.total_server_connect_time.InMillisecondsF() / stats.num_connected;
+    ranked.emplace_back(mean_ms, &entry.first);
+  }
+  size_t num_reported = std::min(ranked.size(), kMaxReportedOrigins);
+  std::partial_sort(ranked.begin(), ranked.begin() + num_reported,
+                    ranked.end(), [](const auto& a, const auto& b) {
+                      return a.first > b.first;
+                    });
+  base::Value slowest(base::Value::Type::LIST);
+  for (size_t i = 0; i < num_reported; i++) {
+    const OriginStats& stats = recent_by_origin[*ranked[i].second];
+    base::Value entry(base::Value::Type::DICTIONARY);
+    entry.SetStringKey("origin", *ranked[i].second);
+    entry.SetDoubleKey("tunnels", stats.count);
+    entry.SetDoubleKey("errors", stats.errors);
+    entry.SetDoubleKey("server_connect_ms", ranked[i].first);
+    if (stats.num_first_bytes > 0) {
+      entry.SetDoubleKey("first_byte_ms",
+                         stats.total_first_byte_time.InMillisecondsF() /
+                             stats.num_first_bytes);
+    }
+    entry.SetDoubleKey("bytes", stats.bytes);
+    slowest.Append(std::move(entry));
+  }
+
+  base::Value dict(base::Value::Type::DICTIONARY);
+  dict.SetKey("total", std::move(total));
+  dict.SetKey("recent", std::move(recent));
+  dict.SetKey("slowest_origins", std::move(slowest));
+  dict.SetDoubleKey(
+      "recent_seconds",
+      (base::TimeTicks::Now() - recent_start_time_).InSecondsF());
+  return dict;
+}
+
+TunnelStatsReporter::TunnelStatsReporter(TunnelStats* stats,
+                                         const base::FilePath& path,
+                                         base::TimeDelta interval)
+    : stats_(stats),
+      path_(path),
+      interval_(interval),
+      file_task_runner_(base::ThreadPool::CreateSequencedTaskRunner(
+          {base::MayBlock(), base::TaskPriority::BEST_EFFORT,
+           base::TaskShutdownBehavior::SKIP_ON_SHUTDOWN})) {}
+
+TunnelStatsReporter::~TunnelStatsReporter() {
+#if defined(OS_POSIX)
+  if (signal_write_fd_.is_valid()) {
+    signal(SIGUSR1, SIG_DFL);
+    g_signal_write_fd = -1;
+  }
+#endif
+}
+
+void TunnelStatsReporter::Start() {
+  timer_.Start(FROM_HERE, interval_,
+               base::BindRepeating(&TunnelStatsReporter::OnTimer,
+                                   base::Unretained(this)));
+
+#if defined(OS_POSIX)
+  int fds[2];
+  if (pipe(fds) != 0) {
+    PLOG(ERROR) << "Failed to create pipe for SIGUSR1";
+    return;
+  }
+  signal_read_fd_.reset(fds[0]);
+  signal_write_fd_.reset(fds[1]);
+  for (int fd : fds) {
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) != 0 ||
+        fcntl(fd, F_SETFD, FD_CLOEXEC) != 0) {
+      PLOG(ERROR) << "Failed to set up pipe for SIGUSR1";
+      signal_write_fd_.reset();
+      return;
+    }
+  }
+  signal_watcher_ =
+      std::make_unique<base::MessagePumpForIO::FdWatchController>(FROM_HERE);
+  if (!base::CurrentIOThread::Get()->WatchFileDescriptor(
+          signal_read_fd_.get(), /*persistent=*/true,
+          base::MessagePumpForIO::WATCH_READ, signal_watcher_.get(), this)) {
+    LOG(ERROR) << "Failed to watch pipe for SIGUSR1";
+    signal_write_fd_.reset();
+    return;
+  }
+  g_signal_write_fd = signal_write_fd_.get();
+  struct sigaction action = {};
+  action.sa_handler = &OnDumpSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGUSR1, &action, nullptr);
+#endif
+}
+
+#if defined(OS_POSIX)
+void TunnelStatsReporter::OnFileCanReadWithoutBlocking(int fd) {
+  char buf[64];
+  while (HANDLE_EINTR(read(fd, buf, sizeof(buf))) > 0) {
+  }
+  std::string json;
+  base::JSONWriter::Write(stats_->ToValue(), &json);
+  LOG(INFO) << "Tunnel stats: " << json;
+  std::string histograms;
+  base::StatisticsRecorder::WriteGraph("Naive.", &histograms);
+  LOG(INFO) << "Histograms:\n" << histograms;
+}
+
+void TunnelStatsReporter::OnFileCanWriteWithoutBlocking(int fd) {
+  NOTREACHED();
+}
+#endif
+
+void TunnelStatsReporter::OnTimer() {
+  if (!path_.empty()) {
+    std::string json;
+    base::JSONWriter::WriteWithOptions(
+        stats_->ToValue(), base::JSONWriter::OPTIONS_PRETTY_PRINT, &json);
+    file_task_runner_->PostTask(
+        FROM_HERE, base::BindOnce(&WriteStatsFile, path_, std::move(json)));
+  }
+  stats_->Rotate();
+}
+
+}  // namespace net
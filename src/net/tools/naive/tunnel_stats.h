@@ -0,0 +1,198 @@
+// Copyright 2026 klzgrad <kizdiv@gmail.com>. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#ifndef NET_TOOLS_NAIVE_TUNNEL_STATS_H_
+#define NET_TOOLS_NAIVE_TUNNEL_STATS_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/scoped_file.h"
+#include "base/memory/scoped_refptr.h"
+#include "base/message_loop/message_pump_for_io.h"
+#include "base/synchronization/lock.h"
+#include "base/task/sequenced_task_runner.h"
+#include "base/thread_annotations.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "base/values.h"
+#include "build/build_config.h"
+#include "net/tools/naive/naive_protocol.h"
+
+namespace net {
+
+// Histogram with power-of-two buckets. Bucket i holds samples in
+// [2^(i-1), 2^i), so percentiles are exact to within a factor of two, which
+// is enough to tell a 10 ms tunnel from a 1 s one without storing samples.
+class LogHistogram {
+ public:
+  static constexpr int kNumBuckets = 48;
+
+  LogHistogram();
+
+  void Add(int64_t sample);
+  void Merge(const LogHistogram& other);
+
+  int64_t count() const { return count_; }
+  // Returns the upper bound of the bucket holding the |percentile|-th
+  // sample, or 0 if there are no samples.
+  int64_t Percentile(int percentile) const;
+  // Returns a dictionary with count, mean, p50, p90, p99 and max.
+  base::Value ToValue() const;
+
+ private:
+  int64_t buckets_[kNumBuckets];
+  int64_t count_;
+  int64_t sum_;
+  int64_t max_;
+};
+
+// Aggregates measurements of closed tunnels, grouped by tunnel type (direct,
+// https, quic, ...) and by origin. Lifetime totals are kept per tunnel type;
+// the recent view covers the current and the previous window, which
+// Rotate() advances. Shared by all IO threads.
+class TunnelStats {
+ public:
+  // Measurements of one tunnel.
+  struct Record {
+    Record();
+    Record(const Record&);
+    ~Record();
+
+    std::string origin;
+    std::string tunnel_type;
+    int result = 0;
+    // Whether the client handshake completed.
+    bool client_connected = false;
+    // Whether the upstream tunnel was established.
+    bool server_connected = false;
+    // Whether any byte arrived from the server.
+    bool has_first_byte = false;
+    // Client handshake (SOCKS, HTTP CONNECT or redir lookup).
+    base::TimeDelta client_connect_time;
+    // Upstream tunnel establishment.
+    base::TimeDelta server_connect_time;
+    // From the tunnel being established to the first byte from the server.
+    base::TimeDelta first_byte_time;
+    base::TimeDelta duration;
+    // Bytes read from each side.
+    int64_t bytes[kNumDirections] = {0, 0};
+    // Times the relay yielded to other tasks.
+    int num_yields = 0;
+  };
+
+  TunnelStats();
+  ~TunnelStats();
+  TunnelStats(const TunnelStats&) = delete;
+  TunnelStats& operator=(const TunnelStats&) = delete;
+
+  void Add(const Record& record);
+
+  // Starts a new window, dropping the oldest one.
+  void Rotate();
+
+  // Returns a dictionary with lifetime totals per tunnel type, recent
+  // histograms per tunnel type, and the recently slowest origins.
+  base::Value ToValue() const;
+
+ private:
+  struct Histograms {
+    Histograms();
+    ~Histograms();
+
+    void Add(const Record& record);
+    void Merge(const Histograms& other);
+    base::Value ToValue() const;
+
+    int64_t errors = 0;
+    LogHistogram client_connect_ms;
+    LogHistogram server_connect_ms;
+    LogHistogram first_byte_ms;
+    LogHistogram duration_ms;
+    LogHistogram bytes_sent;
+    LogHistogram bytes_received;
+    LogHistogram yields;
+  };
+
+  struct OriginStats {
+    int64_t count = 0;
+    int64_t errors = 0;
+    int64_t num_connected = 0;
+    base::TimeDelta total_server_connect_time;
+    int64_t num_first_bytes = 0;
+    base::TimeDelta total_first_byte_time;
+    int64_t bytes = 0;
+  };
+
+  struct Window {
+    Window();
+    ~Window();
+
+    std::map<std::string, Histograms> by_type;
+    std::map<std::string, OriginStats> by_origin;
+  };
+
+  static constexpr int kNumWindows = 2;
+
+  mutable base::Lock lock_;
+  std::map<std::string, Histograms> totals_ GUARDED_BY(lock_);
+  Window windows_[kNumWindows] GUARDED_BY(lock_);
+  int current_window_ GUARDED_BY(lock_);
+  // Start of the previous window and of the current one.
+  base::TimeTicks recent_start_time_ GUARDED_BY(lock_);
+  base::TimeTicks window_start_time_ GUARDED_BY(lock_);
+};
+
+// Rotates |stats| every |interval| and, if |path| is not empty, writes it to
+// |path| as JSON at each rotation. On POSIX, SIGUSR1 dumps |stats| and the
+// Naive.* histograms to the log. Must live on an IO thread.
+class TunnelStatsReporter
+#if defined(OS_POSIX)
+    : public base::MessagePumpForIO::FdWatcher
+#endif
+{
+ public:
+  TunnelStatsReporter(TunnelStats* stats,
+                      const base::FilePath& path,
+                      base::TimeDelta interval);
+#if defined(OS_POSIX)
+  ~TunnelStatsReporter() override;
+#else
+  ~TunnelStatsReporter();
+#endif
+  TunnelStatsReporter(const TunnelStatsReporter&) = delete;
+  TunnelStatsReporter& operator=(const TunnelStatsReporter&) = delete;
+
+  // Starts the timer and installs the signal handler.
+  void Start();
+
+#if defined(OS_POSIX)
+  // base::MessagePumpForIO::FdWatcher methods.
+  void OnFileCanReadWithoutBlocking(int fd) override;
+  void OnFileCanWriteWithoutBlocking(int fd) override;
+#endif
+
+ private:
+  void OnTimer();
+
+  TunnelStats* stats_;
+  base::FilePath path_;
+  base::TimeDelta interval_;
+  base::RepeatingTimer timer_;
+  // Writes |path_| off the IO thread, since it blocks on fsync and rename.
+  scoped_refptr<base::SequencedTaskRunner> file_task_runner_;
+
+#if defined(OS_POSIX)
+  // The signal handler writes to |signal_write_fd_| so that the dump runs
+  // on this thread instead of in the handler.
+  base::ScopedFD signal_read_fd_;
+  base::ScopedFD signal_write_fd_;
+  std::unique_ptr<base::MessagePumpForIO::FdWatchController> signal_watcher_;
+#endif
+};
+
+}  // namespace net
+#endif  // NET_TOOLS_NAIVE_TUNNEL_STATS_H_
@@ -100,6 +100,12 @@ test_naive 'Trivial - auth with special chars' socks5h://^:^@127.0.0.1:60313 \
 test_naive 'Trivial - auth with empty pass' socks5h://user:@127.0.0.1:60314 \
   '--log --listen=socks://user:@127.0.0.1:60314'
 
+test_naive 'Trivial - threads' socks5h://127.0.0.1:60321 \
+  '--log --listen=socks://127.0.0.1:60321 --threads=4'
+
+test_naive 'Trivial - metrics' socks5h://127.0.0.1:60331 \
+  '--log --listen=socks://127.0.0.1:60331 --metrics-listen=127.0.0.1:60332'
+
 test_naive 'SOCKS-SOCKS' socks5h://127.0.0.1:60401 \
   '--log --listen=socks://:60401 --proxy=socks://127.0.0.1:60402' \
   '--log --listen=socks://:60402'